@@ -0,0 +1,200 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "BVH.h"
+#include <algorithm>
+#include <limits>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+/// number of bins used to evaluate the surface area heuristic along an axis
+constexpr int SAH_BINS = 16;
+
+/// cost of traversing an inner node relative to intersecting one primitive
+constexpr Scalar SAH_TRAVERSAL_COST = 0.125;
+
+/// leaves with more primitives are always split (if possible)
+constexpr unsigned int MAX_LEAF_SIZE = 8;
+
+/// half the surface area of the box [_bb_min, _bb_max]
+Scalar half_area(const vec3& _bb_min, const vec3& _bb_max)
+{
+    const vec3 d = _bb_max - _bb_min;
+    return d[0]*d[1] + d[1]*d[2] + d[2]*d[0];
+}
+
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void BVH::build(const std::vector<vec3>& _bb_min, const std::vector<vec3>& _bb_max,
+                unsigned int _granularity)
+{
+    granularity_ = std::max(1u, _granularity);
+
+    assert(_bb_min.size() == _bb_max.size());
+
+    nodes_.clear();
+    indices_.clear();
+    if (_bb_min.empty()) return;
+
+    const unsigned int n = static_cast<unsigned int>(_bb_min.size());
+
+    // the primitives are split by the centers of their bounding boxes
+    std::vector<vec3> centroids(n);
+    indices_.resize(n);
+    for (unsigned int i=0; i<n; ++i)
+    {
+        centroids[i] = 0.5 * (_bb_min[i] + _bb_max[i]);
+        indices_[i]  = i;
+    }
+
+    // a binary tree with at least one primitive per leaf has at most 2n-1 nodes
+    nodes_.reserve(2*n - 1);
+    nodes_.emplace_back();
+    build_recursive(0, 0, n, 0, _bb_min, _bb_max, centroids);
+    nodes_.shrink_to_fit();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void BVH::build_recursive(unsigned int _node, unsigned int _begin, unsigned int _end,
+                          unsigned int _depth,
+                          const std::vector<vec3>& _bb_min,
+                          const std::vector<vec3>& _bb_max,
+                          const std::vector<vec3>& _centroids)
+{
+    // bounding box of all primitives and of their centroids
+    vec3 bb_min(std::numeric_limits<Scalar>::max());
+    vec3 bb_max(std::numeric_limits<Scalar>::lowest());
+    vec3 cb_min(std::numeric_limits<Scalar>::max());
+    vec3 cb_max(std::numeric_limits<Scalar>::lowest());
+    for (unsigned int i=_begin; i<_end; ++i)
+    {
+        const unsigned int p = indices_[i];
+        bb_min = min(bb_min, _bb_min[p]);
+        bb_max = max(bb_max, _bb_max[p]);
+        cb_min = min(cb_min, _centroids[p]);
+        cb_max = max(cb_max, _centroids[p]);
+    }
+
+    nodes_[_node].bb_min = bb_min;
+    nodes_[_node].bb_max = bb_max;
+    nodes_[_node].offset = _begin;
+    nodes_[_node].count  = _end - _begin;
+
+    const unsigned int count = _end - _begin;
+    if (count == 1 || _depth >= MAX_DEPTH) return;
+
+
+    // evaluate the SAH for bin boundaries along all three axes
+    struct Bin
+    {
+        vec3 bb_min = vec3(std::numeric_limits<Scalar>::max());
+        vec3 bb_max = vec3(std::numeric_limits<Scalar>::lowest());
+        unsigned int count = 0;
+    };
+
+    Scalar best_cost  = std::numeric_limits<Scalar>::max();
+    int    best_axis  = -1;
+    int    best_split = 0;
+
+    for (int axis=0; axis<3; ++axis)
+    {
+        const Scalar extent = cb_max[axis] - cb_min[axis];
+        if (extent <= 0.0) continue;
+        const Scalar scale = SAH_BINS / extent;
+
+        Bin bins[SAH_BINS];
+        for (unsigned int i=_begin; i<_end; ++i)
+        {
+            const unsigned int p = indices_[i];
+            const int b = std::min(SAH_BINS-1, int((_centroids[p][axis] - cb_min[axis]) * scale));
+            bins[b].bb_min = min(bins[b].bb_min, _bb_min[p]);
+            bins[b].bb_max = max(bins[b].bb_max, _bb_max[p]);
+            ++bins[b].count;
+        }
+
+        // sweep from the right to collect the cost of all right partitions ...
+        Scalar       right_cost[SAH_BINS];
+        Bin          right;
+        for (int b=SAH_BINS-1; b>0; --b)
+        {
+            right.bb_min  = min(right.bb_min, bins[b].bb_min);
+            right.bb_max  = max(right.bb_max, bins[b].bb_max);
+            right.count  += bins[b].count;
+            right_cost[b] = right.count ? cost(right.count) * half_area(right.bb_min, right.bb_max) : 0.0;
+        }
+
+        // ... and from the left to combine them with the left partitions
+        Bin left;
+        for (int b=0; b<SAH_BINS-1; ++b)
+        {
+            left.bb_min  = min(left.bb_min, bins[b].bb_min);
+            left.bb_max  = max(left.bb_max, bins[b].bb_max);
+            left.count  += bins[b].count;
+            if (left.count == 0 || left.count == count) continue;
+
+            const Scalar c = cost(left.count) * half_area(left.bb_min, left.bb_max) + right_cost[b+1];
+            if (c < best_cost)
+            {
+                best_cost  = c;
+                best_axis  = axis;
+                best_split = b;
+            }
+        }
+    }
+
+    // all centroids coincide: nothing to split
+    if (best_axis < 0) return;
+
+    // keep the leaf if splitting does not pay off
+    const Scalar area      = half_area(bb_min, bb_max);
+    const Scalar leaf_cost = cost(count);
+    const Scalar split_cost = SAH_TRAVERSAL_COST + (area > 0.0 ? best_cost / area : 0.0);
+    if (count <= MAX_LEAF_SIZE && leaf_cost <= split_cost) return;
+
+
+    // partition the primitives at the best bin boundary
+    const Scalar scale = SAH_BINS / (cb_max[best_axis] - cb_min[best_axis]);
+    const auto middle = std::partition(indices_.begin() + _begin, indices_.begin() + _end,
+        [&](unsigned int p)
+        {
+            const int b = std::min(SAH_BINS-1, int((_centroids[p][best_axis] - cb_min[best_axis]) * scale));
+            return b <= best_split;
+        });
+    const unsigned int mid = static_cast<unsigned int>(middle - indices_.begin());
+
+
+    // turn this node into an inner node; its first child directly follows it
+    nodes_[_node].count = 0;
+
+    const unsigned int first = static_cast<unsigned int>(nodes_.size());
+    nodes_.emplace_back();
+    build_recursive(first, _begin, mid, _depth+1, _bb_min, _bb_max, _centroids);
+
+    const unsigned int second = static_cast<unsigned int>(nodes_.size());
+    nodes_.emplace_back();
+    nodes_[_node].offset = second;
+    build_recursive(second, mid, _end, _depth+1, _bb_min, _bb_max, _centroids);
+}
+
+
+//=============================================================================
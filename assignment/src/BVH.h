@@ -0,0 +1,384 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef BVH_H
+#define BVH_H
+
+
+//== INCLUDES =================================================================
+
+#include "Ray.h"
+#include "RayPacket.h"
+#include "vec3.h"
+#include <vector>
+#include <limits>
+#include <utility>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class BVH BVH.h
+/// This class implements a bounding volume hierarchy over a set of primitives,
+/// which are only known to the hierarchy by their axis-aligned bounding boxes.
+/// The hierarchy is built top-down using the surface area heuristic (SAH)
+/// and traversed front-to-back, such that subtrees lying behind the closest
+/// intersection found so far are skipped.
+class BVH
+{
+public:
+
+    /// a node of the hierarchy. Nodes are stored in depth-first order, i.e.,
+    /// the first child of an inner node directly follows its parent.
+    struct Node
+    {
+        /// minimum point of the node's bounding box
+        vec3 bb_min;
+        /// maximum point of the node's bounding box
+        vec3 bb_max;
+        /// leaf: index of the first primitive in BVH::indices_,
+        /// inner node: index of the second child
+        unsigned int offset;
+        /// number of primitives in a leaf, 0 for inner nodes
+        unsigned int count;
+    };
+
+    /// Build the hierarchy for primitives with the given bounding boxes.
+    /// \param[in] _bb_min minimum points of the primitives' bounding boxes
+    /// \param[in] _bb_max maximum points of the primitives' bounding boxes
+    /// \param[in] _granularity number of primitives that the caller
+    /// intersects at the cost of one, e.g. with SIMD instructions. The SAH
+    /// then counts the primitives of a leaf in groups of this size, which
+    /// avoids leaves that fill these groups only partially.
+    void build(const std::vector<vec3>& _bb_min, const std::vector<vec3>& _bb_max,
+               unsigned int _granularity = 1);
+
+    /// Traverse the hierarchy front-to-back and call \c _intersect for every
+    /// primitive in a leaf whose bounding box is hit by \c _ray within its
+    /// interval [tmin, tmax]. \c _intersect is called as `_intersect(i, _ray)`
+    /// with the primitive index \c i (as passed to build()) and is responsible
+    /// for shrinking `_ray.tmax` whenever it finds a closer intersection.
+    template <class Intersector>
+    void traverse(Ray& _ray, Intersector&& _intersect) const;
+
+    /// Traverse the hierarchy and call \c _occluded for the primitives in all
+    /// leaves hit by \c _ray within its interval, until it returns true for the
+    /// first time. \c _occluded is called as `_occluded(i)` with the primitive
+    /// index \c i (as passed to build()). Returns whether any call returned true.
+    template <class Occluder>
+    bool occluded(const Ray& _ray, Occluder&& _occluded) const;
+
+    /// Like traverse(), but call \c _intersect once per leaf as
+    /// `_intersect(n, _ray)` with the index \c n of the leaf in nodes().
+    /// This lets callers intersect all primitives of a leaf at once.
+    template <class LeafIntersector>
+    void traverse_leaves(Ray& _ray, LeafIntersector&& _intersect) const;
+
+    /// Like occluded(), but call \c _occluded once per leaf as `_occluded(n)`
+    /// with the index \c n of the leaf in nodes().
+    template <class LeafOccluder>
+    bool occluded_leaves(const Ray& _ray, LeafOccluder&& _occluded) const;
+
+    /// Traverse the hierarchy front-to-back with the rays of \c _packet selected
+    /// by \c _mask. Each node is fetched once for the whole packet and visited
+    /// if any of these rays hits its box within the ray's interval. \c _intersect
+    /// is called once per leaf as `_intersect(n, _packet, lanes)`, where \c lanes
+    /// masks the rays hitting the leaf's box, and is responsible for shrinking
+    /// their `tmax` whenever it finds closer intersections.
+    template <class LeafIntersector>
+    void traverse_packet(RayPacket& _packet, unsigned int _mask, LeafIntersector&& _intersect) const;
+
+    /// Index (as passed to build()) of the primitive at position \c _i of the
+    /// leaf ranges, i.e., leaf \c n holds the primitives at positions
+    /// nodes()[n].offset to nodes()[n].offset + nodes()[n].count - 1.
+    unsigned int primitive(unsigned int _i) const { return indices_[_i]; }
+
+    /// Is the hierarchy empty?
+    bool empty() const { return nodes_.empty(); }
+
+    /// Array of nodes (the root is the first node)
+    const std::vector<Node>& nodes() const { return nodes_; }
+
+    /// Array of primitive indices referenced by the leaves, see primitive()
+    const std::vector<unsigned int>& indices() const { return indices_; }
+
+    /// Replace the hierarchy by \c _nodes and \c _indices, as returned by
+    /// nodes() and indices() of a hierarchy built earlier (e.g., one that
+    /// was stored in a file).
+    void assign(std::vector<Node> _nodes, std::vector<unsigned int> _indices)
+    {
+        nodes_   = std::move(_nodes);
+        indices_ = std::move(_indices);
+    }
+
+    /// Intersect \c _ray with the box [_bb_min, _bb_max] (slab test). Return
+    /// whether the ray overlaps the box within [_ray.tmin, _ray.tmax] and store
+    /// the entry parameter in \c _tentry.
+    static bool intersect_box(const vec3& _bb_min, const vec3& _bb_max,
+                              const Ray& _ray, Scalar& _tentry);
+
+private:
+
+    /// the SAH cost of intersecting \c _count primitives
+    Scalar cost(unsigned int _count) const
+    {
+        return Scalar((_count + granularity_ - 1) / granularity_);
+    }
+
+    /// recursively build the subtree for the primitives indices_[_begin.._end)
+    void build_recursive(unsigned int _node, unsigned int _begin, unsigned int _end,
+                         unsigned int _depth,
+                         const std::vector<vec3>& _bb_min,
+                         const std::vector<vec3>& _bb_max,
+                         const std::vector<vec3>& _centroids);
+
+private:
+
+    /// maximum depth of the hierarchy, bounds the traversal stack
+    static constexpr unsigned int MAX_DEPTH = 64;
+
+    /// Array of nodes in depth-first order
+    std::vector<Node> nodes_;
+
+    /// Primitive indices, ordered such that every leaf references a contiguous range
+    std::vector<unsigned int> indices_;
+
+    /// number of primitives intersected at the cost of one, see build()
+    unsigned int granularity_ = 1;
+};
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+inline bool BVH::intersect_box(const vec3& _bb_min, const vec3& _bb_max,
+                               const Ray& _ray, Scalar& _tentry)
+{
+    const vec3* bounds[2] = { &_bb_min, &_bb_max };
+
+    Scalar t0 = _ray.tmin, t1 = _ray.tmax;
+    for (int i=0; i<3; ++i)
+    {
+        // the ray's sign selects which slab plane is entered first
+        const Scalar tnear = ((*bounds[  _ray.sign[i]])[i] - _ray.origin[i]) * _ray.inv_direction[i];
+        const Scalar tfar  = ((*bounds[1-_ray.sign[i]])[i] - _ray.origin[i]) * _ray.inv_direction[i];
+
+        // comparisons with NaN (ray in the slab's plane) leave t0, t1 unchanged
+        if (tnear > t0) t0 = tnear;
+        if (tfar  < t1) t1 = tfar;
+        if (t0 > t1) return false;
+    }
+    _tentry = t0;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Intersector>
+void BVH::traverse(Ray& _ray, Intersector&& _intersect) const
+{
+    traverse_leaves(_ray, [&](unsigned int n, Ray& r)
+    {
+        const Node& node = nodes_[n];
+        for (unsigned int i=node.offset; i<node.offset+node.count; ++i)
+            _intersect(indices_[i], r);
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Occluder>
+bool BVH::occluded(const Ray& _ray, Occluder&& _occluded) const
+{
+    return occluded_leaves(_ray, [&](unsigned int n)
+    {
+        const Node& node = nodes_[n];
+        for (unsigned int i=node.offset; i<node.offset+node.count; ++i)
+            if (_occluded(indices_[i])) return true;
+        return false;
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class LeafIntersector>
+void BVH::traverse_leaves(Ray& _ray, LeafIntersector&& _intersect) const
+{
+    if (nodes_.empty()) return;
+
+    Scalar tentry;
+    if (!intersect_box(nodes_[0].bb_min, nodes_[0].bb_max, _ray, tentry))
+        return;
+
+    // stack of nodes still to visit, together with their entry parameter
+    struct Entry { unsigned int node; Scalar tentry; };
+    Entry stack[MAX_DEPTH + 1];
+    int   top = 0;
+    stack[top++] = Entry{0, tentry};
+
+    while (top > 0)
+    {
+        const Entry entry = stack[--top];
+
+        // skip nodes that lie behind the closest intersection found so far
+        if (entry.tentry > _ray.tmax) continue;
+
+        const Node& node = nodes_[entry.node];
+        if (node.count > 0)
+        {
+            _intersect(entry.node, _ray);
+            continue;
+        }
+
+        // visit the nearer child first by pushing it last
+        const unsigned int first = entry.node + 1, second = node.offset;
+        Scalar tfirst, tsecond;
+        const bool hit_first  = intersect_box(nodes_[first].bb_min,  nodes_[first].bb_max,  _ray, tfirst);
+        const bool hit_second = intersect_box(nodes_[second].bb_min, nodes_[second].bb_max, _ray, tsecond);
+        if (hit_first && hit_second)
+        {
+            if (tfirst <= tsecond)
+            {
+                stack[top++] = Entry{second, tsecond};
+                stack[top++] = Entry{first,  tfirst};
+            }
+            else
+            {
+                stack[top++] = Entry{first,  tfirst};
+                stack[top++] = Entry{second, tsecond};
+            }
+        }
+        else if (hit_first)  stack[top++] = Entry{first,  tfirst};
+        else if (hit_second) stack[top++] = Entry{second, tsecond};
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class LeafIntersector>
+void BVH::traverse_packet(RayPacket& _packet, unsigned int _mask, LeafIntersector&& _intersect) const
+{
+    if (nodes_.empty()) return;
+
+    // intersect the box of node _n with all rays in _lanes, return the mask
+    // of rays that hit it, and the smallest entry parameter among them
+    auto intersect_node = [&](unsigned int _n, unsigned int _lanes, Scalar& _tentry)
+    {
+        unsigned int hits = 0;
+        Scalar       t;
+        _tentry = std::numeric_limits<Scalar>::max();
+        for (int i=0; i<RayPacket::SIZE; ++i)
+        {
+            if ((_lanes & (1u << i)) &&
+                intersect_box(nodes_[_n].bb_min, nodes_[_n].bb_max, _packet.ray[i], t))
+            {
+                hits   |= (1u << i);
+                _tentry = std::min(_tentry, t);
+            }
+        }
+        return hits;
+    };
+
+    Scalar tentry;
+    const unsigned int lanes = intersect_node(0, _mask, tentry);
+    if (!lanes) return;
+
+    // stack of nodes still to visit, with the rays that hit them
+    struct Entry { unsigned int node; unsigned int lanes; Scalar tentry; };
+    Entry stack[MAX_DEPTH + 1];
+    int   top = 0;
+    stack[top++] = Entry{0, lanes, tentry};
+
+    while (top > 0)
+    {
+        Entry entry = stack[--top];
+
+        // drop rays whose closest intersection lies in front of the node
+        for (int i=0; i<RayPacket::SIZE; ++i)
+            if (entry.tentry > _packet.ray[i].tmax) entry.lanes &= ~(1u << i);
+        if (!entry.lanes) continue;
+
+        const Node& node = nodes_[entry.node];
+        if (node.count > 0)
+        {
+            _intersect(entry.node, _packet, entry.lanes);
+            continue;
+        }
+
+        // visit the child entered first (by any ray) first by pushing it last
+        const unsigned int first = entry.node + 1, second = node.offset;
+        Scalar tfirst, tsecond;
+        const unsigned int lanes_first  = intersect_node(first,  entry.lanes, tfirst);
+        const unsigned int lanes_second = intersect_node(second, entry.lanes, tsecond);
+        if (lanes_first && lanes_second)
+        {
+            if (tfirst <= tsecond)
+            {
+                stack[top++] = Entry{second, lanes_second, tsecond};
+                stack[top++] = Entry{first,  lanes_first,  tfirst};
+            }
+            else
+            {
+                stack[top++] = Entry{first,  lanes_first,  tfirst};
+                stack[top++] = Entry{second, lanes_second, tsecond};
+            }
+        }
+        else if (lanes_first)  stack[top++] = Entry{first,  lanes_first,  tfirst};
+        else if (lanes_second) stack[top++] = Entry{second, lanes_second, tsecond};
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class LeafOccluder>
+bool BVH::occluded_leaves(const Ray& _ray, LeafOccluder&& _occluded) const
+{
+    if (nodes_.empty()) return false;
+
+    // any occluder will do, so children are visited in storage order
+    unsigned int stack[MAX_DEPTH + 1];
+    int          top = 0;
+    stack[top++] = 0;
+
+    Scalar tentry;
+    while (top > 0)
+    {
+        const unsigned int index = stack[--top];
+        const Node& node = nodes_[index];
+        if (!intersect_box(node.bb_min, node.bb_max, _ray, tentry)) continue;
+
+        if (node.count > 0)
+        {
+            if (_occluded(index)) return true;
+        }
+        else
+        {
+            stack[top++] = node.offset;
+            stack[top++] = index + 1;
+        }
+    }
+
+    return false;
+}
+
+
+//=============================================================================
+#endif // BVH_H defined
+//=============================================================================
@@ -43,7 +43,7 @@ public:
     Camera(const vec3&   _eye,
            const vec3&   _center,
            const vec3&   _up,
-           double        _fovy,
+           Scalar        _fovy,
            unsigned int  _width,
            unsigned int  _height)
     : eye(_eye), center(_center), up(_up), fovy(_fovy), width(_width), height(_height)
@@ -57,15 +57,15 @@ public:
     {
         // compute viewing direction and distance of eye to scene center
         vec3  view = normalize(center - eye);
-        double dist = distance(center, eye);
+        Scalar dist = distance(center, eye);
 
         // compute width & height of the image plane
         // based on the opening angle of the camera (fovy) and the distance
         // of the eye to the near plane (dist)
-        double w = width;
-        double h = height;
-        double image_height = 2.0 * dist * tan(0.5*fovy/180.0*M_PI);
-        double image_width  = w/h * image_height;
+        Scalar w = width;
+        Scalar h = height;
+        Scalar image_height = 2.0 * dist * tan(0.5*fovy/180.0*M_PI);
+        Scalar image_width  = w/h * image_height;
 
         // compute right and up vectors on the image plane
         x_dir = normalize( cross(view, up) ) * image_width / w;
@@ -81,7 +81,17 @@ public:
     /// \param[in] _y pixel location in image
     Ray primary_ray(unsigned int _x, unsigned int _y) const
     {
-        return Ray(eye, lower_left + static_cast<double>(_x)*x_dir + static_cast<double>(_y)*y_dir - eye);
+        return Ray(eye, lower_left + static_cast<Scalar>(_x)*x_dir + static_cast<Scalar>(_y)*y_dir - eye);
+    }
+
+    /// create a ray through a point within a pixel in the image
+    /// \param[in] _x pixel location in image
+    /// \param[in] _y pixel location in image
+    /// \param[in] _dx offset within the pixel in x-direction (in [0,1), 0 for primary_ray(_x,_y))
+    /// \param[in] _dy offset within the pixel in y-direction (in [0,1), 0 for primary_ray(_x,_y))
+    Ray primary_ray(unsigned int _x, unsigned int _y, Scalar _dx, Scalar _dy) const
+    {
+        return Ray(eye, lower_left + (static_cast<Scalar>(_x) + _dx)*x_dir + (static_cast<Scalar>(_y) + _dy)*y_dir - eye);
     }
 
 
@@ -97,7 +107,7 @@ public:
     vec3 up;
 
     /// opening angle (field of view) in y-direction
-    double  fovy;
+    Scalar  fovy;
 
     /// image width in pixels
     unsigned int width;
@@ -23,27 +23,27 @@ Cylinder::
 intersect(const Ray&  _ray,
           vec3&       _intersection_point,
           vec3&       _intersection_normal,
-          double&     _intersection_t) const
+          Scalar&     _intersection_t) const
 {
     // Solve for where _ray intersects an infinite extension of the cylinder
     const vec3 &dir = _ray.direction;
     const vec3   oc = _ray.origin - center;
 
-    const double dir_parallel = dot(axis, dir),
+    const Scalar dir_parallel = dot(axis, dir),
                   oc_parallel = dot(axis, oc);
 
-    std::array<double, 2> t;
+    std::array<Scalar, 2> t;
     size_t nsol = solveQuadratic(
             dot(dir, dir) - dir_parallel * dir_parallel,
             2.0 * (dot(dir, oc) - dir_parallel * oc_parallel),
             dot(oc, oc) - oc_parallel * oc_parallel - radius * radius, t);
 
     // Find the closest valid solution
-    // (in front of the viewer and within the cylinder's height).
+    // (within the ray's interval and within the cylinder's height).
     _intersection_t = NO_INTERSECTION;
     for (size_t i = 0; i < nsol; ++i) {
-        if (t[i] <= 0) continue;
-        double z = dot(_ray(t[i]) - center, axis);
+        if (t[i] <= _ray.tmin || t[i] >= _ray.tmax) continue;
+        Scalar z = dot(_ray(t[i]) - center, axis);
         if (2 * std::abs(z) < height)
             _intersection_t = std::min(_intersection_t, t[i]);
     }
@@ -61,3 +61,109 @@ intersect(const Ray&  _ray,
 
     return true;
 }
+
+
+//-----------------------------------------------------------------------------
+
+
+unsigned int
+Cylinder::
+intersect_packet(const RayPacket& _packet,
+                 unsigned int     _mask,
+                 vec3             _intersection_point[],
+                 vec3             _intersection_normal[],
+                 Scalar           _intersection_t[]) const
+{
+    // coefficients of the quadratic equations of all rays
+    const vec3xN<RayPacket::SIZE> dir = _packet.directions;
+    const vec3xN<RayPacket::SIZE>  oc = _packet.origins - center;
+
+    const scalarN<RayPacket::SIZE> dir_parallel = dot(axis, dir),
+                                    oc_parallel = dot(axis, oc);
+
+    const scalarN<RayPacket::SIZE> a = dot(dir, dir) - dir_parallel * dir_parallel;
+    const scalarN<RayPacket::SIZE> b = Scalar(2) * (dot(dir, oc) - dir_parallel * oc_parallel);
+    const scalarN<RayPacket::SIZE> c = dot(oc, oc) - oc_parallel * oc_parallel - scalarN<RayPacket::SIZE>(radius * radius);
+
+    unsigned int hits = 0;
+    for (int l=0; l<RayPacket::SIZE; ++l)
+    {
+        if (!(_mask & (1u << l))) continue;
+        const Ray& ray = _packet.ray[l];
+
+        std::array<Scalar, 2> t;
+        size_t nsol = solveQuadratic(a[l], b[l], c[l], t);
+
+        // Find the closest valid solution
+        // (within the ray's interval and within the cylinder's height).
+        Scalar tmin = NO_INTERSECTION;
+        for (size_t i = 0; i < nsol; ++i) {
+            if (t[i] <= ray.tmin || t[i] >= ray.tmax) continue;
+            Scalar z = dot(ray(t[i]) - center, axis);
+            if (2 * std::abs(z) < height)
+                tmin = std::min(tmin, t[i]);
+        }
+        if (tmin == NO_INTERSECTION) continue;
+
+        // compute intersection data
+        vec3& normal = _intersection_normal[l];
+        _intersection_t[l]     = tmin;
+        _intersection_point[l] = ray(tmin);
+        normal  = (_intersection_point[l] - center) / radius;
+        normal -= dot(normal, axis) * axis;
+
+        // Choose the normal's orientation to be opposite the ray's
+        // (in case the ray intersects the inside surface)
+        if (dot(normal, ray.direction) > 0)
+            normal *= -1.0;
+
+        hits |= (1u << l);
+    }
+    return hits;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Cylinder::occluded(const Ray& _ray) const
+{
+    const vec3 &dir = _ray.direction;
+    const vec3   oc = _ray.origin - center;
+
+    const Scalar dir_parallel = dot(axis, dir),
+                  oc_parallel = dot(axis, oc);
+
+    std::array<Scalar, 2> t;
+    size_t nsol = solveQuadratic(
+            dot(dir, dir) - dir_parallel * dir_parallel,
+            2.0 * (dot(dir, oc) - dir_parallel * oc_parallel),
+            dot(oc, oc) - oc_parallel * oc_parallel - radius * radius, t);
+
+    // any solution within the ray's interval and the cylinder's height will do
+    for (size_t i = 0; i < nsol; ++i) {
+        if (t[i] <= _ray.tmin || t[i] >= _ray.tmax) continue;
+        if (2 * std::abs(oc_parallel + t[i] * dir_parallel) < height) return true;
+    }
+
+    return false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Cylinder::bounds(vec3& _bb_min, vec3& _bb_max) const
+{
+    // extent of the two rim circles plus half the height along the axis
+    vec3 extent;
+    for (int i=0; i<3; ++i)
+    {
+        extent[i] = 0.5 * height * std::abs(axis[i]) +
+                    radius * std::sqrt(std::max(0.0, 1.0 - axis[i]*axis[i]));
+    }
+
+    _bb_min = center - extent;
+    _bb_max = center + extent;
+    return true;
+}
@@ -30,9 +30,9 @@ class Cylinder : public Object
 public:
     /// Construct a cylinder by directly specifying its parameters
     Cylinder(const vec3 &_center = vec3(0,0,0),
-             double _radius = 1,
+             Scalar _radius = 1,
              const vec3 &_axis = vec3(1,0,0),
-             double _height = 1)
+             Scalar _height = 1)
         :  center(_center), radius(_radius), axis(_axis), height(_height) { }
 
     /// Construct a cylinder with parameters parsed from an input stream.
@@ -48,7 +48,24 @@ public:
     virtual bool intersect(const Ray&  _ray,
                            vec3&       _intersection_point,
                            vec3&       _intersection_normal,
-                           double&     _intersection_t) const override;
+                           Scalar&     _intersection_t) const override;
+
+    /// Intersect the cylinder with the rays of \c _packet selected by \c _mask,
+    /// computing the quadratic equations of all rays at once.
+    /// This function overrides Object::intersect_packet().
+    virtual unsigned int intersect_packet(const RayPacket& _packet,
+                                          unsigned int     _mask,
+                                          vec3             _intersection_point[],
+                                          vec3             _intersection_normal[],
+                                          Scalar           _intersection_t[]) const override;
+
+    /// Does \c _ray hit the cylinder within its interval?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray) const override;
+
+    /// Compute the bounding box of the cylinder.
+    /// This function overrides Object::bounds().
+    virtual bool bounds(vec3& _bb_min, vec3& _bb_max) const override;
 
     /// parse cylinder from an input stream
     virtual void parse(std::istream &is) override {
@@ -64,10 +81,10 @@ private:
     vec3 axis;
 
     /// radius
-    double radius;
+    Scalar radius;
 
     /// height
-    double height;
+    Scalar height;
 };
 
 //=============================================================================
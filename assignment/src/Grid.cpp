@@ -0,0 +1,108 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "Grid.h"
+#include <algorithm>
+#include <cmath>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+/// number of cells per primitive the automatic resolution aims for
+constexpr Scalar GRID_DENSITY = 3.0;
+
+/// maximum number of cells along each axis
+constexpr int GRID_MAX_RESOLUTION = 128;
+
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Grid::build(const std::vector<vec3>& _bb_min, const std::vector<vec3>& _bb_max)
+{
+    assert(_bb_min.size() == _bb_max.size());
+
+    cell_offsets_.clear();
+    cell_primitives_.clear();
+    if (_bb_min.empty()) return;
+
+    const unsigned int n = static_cast<unsigned int>(_bb_min.size());
+
+
+    // bounding box of all primitives
+    bb_min_ = vec3(std::numeric_limits<Scalar>::max());
+    bb_max_ = vec3(std::numeric_limits<Scalar>::lowest());
+    for (unsigned int i=0; i<n; ++i)
+    {
+        bb_min_ = min(bb_min_, _bb_min[i]);
+        bb_max_ = max(bb_max_, _bb_max[i]);
+    }
+
+    // give flat boxes some thickness, such that every cell has a volume
+    vec3 extent = bb_max_ - bb_min_;
+    const Scalar eps = 1e-6 * std::max(Scalar(1), std::max(extent[0], std::max(extent[1], extent[2])));
+    for (int i=0; i<3; ++i)
+    {
+        if (extent[i] < eps)
+        {
+            bb_min_[i] -= eps;
+            bb_max_[i] += eps;
+            extent[i]  += 2.0*eps;
+        }
+    }
+
+
+    // choose roughly cubic cells, about GRID_DENSITY cells per primitive
+    const Scalar cells_per_unit = std::cbrt(GRID_DENSITY * n / (extent[0]*extent[1]*extent[2]));
+    for (int i=0; i<3; ++i)
+    {
+        res_[i]           = std::max(1, std::min(GRID_MAX_RESOLUTION, int(extent[i] * cells_per_unit)));
+        cell_size_[i]     = extent[i] / res_[i];
+        inv_cell_size_[i] = 1.0 / cell_size_[i];
+    }
+    const unsigned int num_cells = res_[0] * res_[1] * res_[2];
+
+
+    // count the primitives overlapping each cell, then turn the counts into
+    // offsets and fill in the primitives in a second pass over the same cells
+    cell_offsets_.assign(num_cells + 1, 0);
+
+    auto for_each_cell = [&](unsigned int _i, auto&& _f)
+    {
+        const int x0 = cell_coordinate(_bb_min[_i][0], 0), x1 = cell_coordinate(_bb_max[_i][0], 0);
+        const int y0 = cell_coordinate(_bb_min[_i][1], 1), y1 = cell_coordinate(_bb_max[_i][1], 1);
+        const int z0 = cell_coordinate(_bb_min[_i][2], 2), z1 = cell_coordinate(_bb_max[_i][2], 2);
+        for (int z=z0; z<=z1; ++z)
+            for (int y=y0; y<=y1; ++y)
+                for (int x=x0; x<=x1; ++x)
+                    _f((z*res_[1] + y)*res_[0] + x);
+    };
+
+    for (unsigned int i=0; i<n; ++i)
+        for_each_cell(i, [&](unsigned int c) { ++cell_offsets_[c+1]; });
+
+    for (unsigned int c=0; c<num_cells; ++c)
+        cell_offsets_[c+1] += cell_offsets_[c];
+
+    cell_primitives_.resize(cell_offsets_[num_cells]);
+    std::vector<unsigned int> fill(cell_offsets_.begin(), cell_offsets_.end()-1);
+    for (unsigned int i=0; i<n; ++i)
+        for_each_cell(i, [&](unsigned int c) { cell_primitives_[fill[c]++] = i; });
+}
+
+
+//=============================================================================
@@ -0,0 +1,210 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef GRID_H
+#define GRID_H
+
+
+//== INCLUDES =================================================================
+
+#include "BVH.h"
+#include "Ray.h"
+#include "vec3.h"
+#include <vector>
+#include <limits>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class Grid Grid.h
+/// This class implements a uniform grid over a set of primitives, which are
+/// only known to the grid by their axis-aligned bounding boxes. Every cell
+/// stores the primitives whose bounding box overlaps it. The resolution is
+/// chosen automatically from the number of primitives, and rays walk the
+/// cells front-to-back using a 3D digital differential analyzer (3D-DDA).
+/// It offers the same interface as BVH, but is built in linear time.
+class Grid
+{
+public:
+
+    /// Build the grid for primitives with the given bounding boxes.
+    /// \param[in] _bb_min minimum points of the primitives' bounding boxes
+    /// \param[in] _bb_max maximum points of the primitives' bounding boxes
+    void build(const std::vector<vec3>& _bb_min, const std::vector<vec3>& _bb_max);
+
+    /// Walk the cells pierced by \c _ray front-to-back and call \c _intersect
+    /// for every primitive stored in them, until a cell ends behind `_ray.tmax`.
+    /// \c _intersect is called as `_intersect(i, _ray)` with the primitive
+    /// index \c i (as passed to build()) and is responsible for shrinking
+    /// `_ray.tmax` whenever it finds a closer intersection. Primitives
+    /// overlapping several cells may be passed more than once.
+    template <class Intersector>
+    void traverse(Ray& _ray, Intersector&& _intersect) const;
+
+    /// Walk the cells pierced by \c _ray within its interval and call
+    /// \c _occluded for the primitives stored in them, until it returns true
+    /// for the first time. \c _occluded is called as `_occluded(i)` with the
+    /// primitive index \c i (as passed to build()). Returns whether any call
+    /// returned true.
+    template <class Occluder>
+    bool occluded(const Ray& _ray, Occluder&& _occluded) const;
+
+    /// Is the grid empty?
+    bool empty() const { return cell_offsets_.empty(); }
+
+    /// Number of bytes allocated for the cells
+    size_t memory() const
+    {
+        return (cell_offsets_.capacity() + cell_primitives_.capacity()) * sizeof(unsigned int);
+    }
+
+    /// number of cells along x, y, and z
+    const int* resolution() const { return res_; }
+
+private:
+
+    /// Walk the cells pierced by \c _ray front-to-back using a 3D-DDA and
+    /// call `_visit(c, texit)` for every cell index \c c, where \c texit is the
+    /// ray parameter at which the ray leaves the cell. Stop as soon as
+    /// \c _visit returns true.
+    template <class CellVisitor>
+    void walk(const Ray& _ray, CellVisitor&& _visit) const;
+
+    /// index of the cell containing coordinate \c _x along \c _axis (clamped)
+    int cell_coordinate(Scalar _x, int _axis) const
+    {
+        const int c = int((_x - bb_min_[_axis]) * inv_cell_size_[_axis]);
+        return std::max(0, std::min(res_[_axis]-1, c));
+    }
+
+private:
+
+    /// minimum point of the grid's bounding box
+    vec3 bb_min_ = vec3(0);
+    /// maximum point of the grid's bounding box
+    vec3 bb_max_ = vec3(0);
+
+    /// size of a cell along x, y, and z
+    vec3 cell_size_ = vec3(0);
+    /// inverse size of a cell along x, y, and z
+    vec3 inv_cell_size_ = vec3(0);
+
+    /// number of cells along x, y, and z
+    int res_[3] = {0, 0, 0};
+
+    /// primitives of cell c are cell_primitives_[cell_offsets_[c] .. cell_offsets_[c+1])
+    std::vector<unsigned int> cell_offsets_;
+
+    /// concatenated primitive lists of all cells
+    std::vector<unsigned int> cell_primitives_;
+};
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+template <class CellVisitor>
+void Grid::walk(const Ray& _ray, CellVisitor&& _visit) const
+{
+    if (cell_offsets_.empty()) return;
+
+    Scalar tentry;
+    if (!BVH::intersect_box(bb_min_, bb_max_, _ray, tentry))
+        return;
+
+    // setup the 3D-DDA: the cell containing the entry point, the step
+    // direction, and the ray parameters at which the next cell boundary
+    // is crossed along each axis
+    const vec3 entry = _ray(tentry);
+    int    cell[3], step[3], out[3];
+    Scalar tnext[3], tdelta[3];
+    for (int i=0; i<3; ++i)
+    {
+        cell[i] = cell_coordinate(entry[i], i);
+        if (_ray.direction[i] > 0.0)
+        {
+            step[i]   = 1;
+            out[i]    = res_[i];
+            tnext[i]  = tentry + (bb_min_[i] + (cell[i]+1)*cell_size_[i] - entry[i]) * _ray.inv_direction[i];
+            tdelta[i] = cell_size_[i] * _ray.inv_direction[i];
+        }
+        else if (_ray.direction[i] < 0.0)
+        {
+            step[i]   = -1;
+            out[i]    = -1;
+            tnext[i]  = tentry + (bb_min_[i] + cell[i]*cell_size_[i] - entry[i]) * _ray.inv_direction[i];
+            tdelta[i] = -cell_size_[i] * _ray.inv_direction[i];
+        }
+        else
+        {
+            step[i]   = 0;
+            out[i]    = -1;
+            tnext[i]  = std::numeric_limits<Scalar>::max();
+            tdelta[i] = 0.0;
+        }
+    }
+
+    for (;;)
+    {
+        // the axis whose cell boundary is crossed first
+        const int axis = (tnext[0] < tnext[1])
+                       ? (tnext[0] < tnext[2] ? 0 : 2)
+                       : (tnext[1] < tnext[2] ? 1 : 2);
+
+        const unsigned int c = (cell[2]*res_[1] + cell[1])*res_[0] + cell[0];
+        if (_visit(c, tnext[axis])) return;
+
+        cell[axis] += step[axis];
+        if (cell[axis] == out[axis]) return;
+        tnext[axis] += tdelta[axis];
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Intersector>
+void Grid::traverse(Ray& _ray, Intersector&& _intersect) const
+{
+    walk(_ray, [&](unsigned int c, Scalar texit)
+    {
+        for (unsigned int i=cell_offsets_[c]; i<cell_offsets_[c+1]; ++i)
+            _intersect(cell_primitives_[i], _ray);
+
+        // hits in later cells cannot be closer than the current closest one
+        return _ray.tmax <= texit;
+    });
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+template <class Occluder>
+bool Grid::occluded(const Ray& _ray, Occluder&& _occluded) const
+{
+    bool occluded = false;
+    walk(_ray, [&](unsigned int c, Scalar texit)
+    {
+        for (unsigned int i=cell_offsets_[c]; i<cell_offsets_[c+1]; ++i)
+            if (_occluded(cell_primitives_[i])) return (occluded = true);
+
+        // cells behind the end of the ray cannot occlude it
+        return _ray.tmax <= texit;
+    });
+    return occluded;
+}
+
+
+//=============================================================================
+#endif // GRID_H defined
+//=============================================================================
@@ -0,0 +1,302 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "Image.h"
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+/// maximum number of pixels in a TGA run-length packet
+constexpr unsigned int MAX_PACKET = 128;
+
+/// Run-length encode the \c _n BGR pixels at \c _row to \c _out, which has
+/// to hold at least 3*_n + ceil(_n/128) bytes. Packets do not cross rows, as
+/// some readers expect. Returns the end of the encoded bytes.
+unsigned char* encode_rle(const unsigned char* _row, unsigned int _n, unsigned char* _out)
+{
+    auto same = [&](unsigned int _i, unsigned int _j)
+    {
+        const unsigned char* p = _row + 3*size_t(_i);
+        const unsigned char* q = _row + 3*size_t(_j);
+        return p[0] == q[0] && p[1] == q[1] && p[2] == q[2];
+    };
+
+    unsigned int i = 0;
+    while (i < _n)
+    {
+        // a run of (at least two) equal pixels
+        unsigned int run = 1;
+        while (i + run < _n && run < MAX_PACKET && same(i, i + run)) ++run;
+        if (run > 1)
+        {
+            *_out++ = static_cast<unsigned char>(0x80 | (run - 1));
+            std::memcpy(_out, _row + 3*size_t(i), 3);
+            _out += 3;
+            i    += run;
+            continue;
+        }
+
+        // raw pixels up to the next run
+        unsigned int raw = 1;
+        while (i + raw < _n && raw < MAX_PACKET &&
+               !(i + raw + 1 < _n && same(i + raw, i + raw + 1))) ++raw;
+        *_out++ = static_cast<unsigned char>(raw - 1);
+        std::memcpy(_out, _row + 3*size_t(i), 3*raw);
+        _out += 3*raw;
+        i    += raw;
+    }
+    return _out;
+}
+
+/// The file header of an image of size \c _width x \c _height in format
+/// \c _format. TGA images are run-length encoded if \c _rle is true. Throws
+/// std::runtime_error if the format cannot store the size.
+std::string header(Image::Format _format, unsigned int _width, unsigned int _height, bool _rle)
+{
+    char buffer[64];
+    switch (_format)
+    {
+        case Image::TGA:
+        {
+            if (_width > Image::max_size(_format) || _height > Image::max_size(_format))
+                throw std::runtime_error("TGA images are limited to 65535x65535 pixels, use .ppm or .pfm");
+            const unsigned char tga[18] =
+            {
+                0,  // id length
+                0,  // no color map
+                static_cast<unsigned char>(_rle ? 10 : 2), // (run-length encoded) true-color image
+                0, 0, 0, 0, 0, // color map specification
+                0, 0, 0, 0,    // origin of the image (lower left)
+                static_cast<unsigned char>(_width  & 0xFF), static_cast<unsigned char>(_width  >> 8),
+                static_cast<unsigned char>(_height & 0xFF), static_cast<unsigned char>(_height >> 8),
+                24, // bits per pixel
+                0   // image descriptor
+            };
+            return std::string(reinterpret_cast<const char*>(tga), sizeof(tga));
+        }
+
+        case Image::PPM:
+            std::snprintf(buffer, sizeof(buffer), "P6\n%u %u\n255\n", _width, _height);
+            return buffer;
+
+        case Image::PFM:
+        {
+            // a negative scale denotes little-endian floats
+            const uint16_t endian = 1;
+            const bool     little = *reinterpret_cast<const unsigned char*>(&endian) == 1;
+            std::snprintf(buffer, sizeof(buffer), "PF\n%u %u\n%s\n", _width, _height, little ? "-1.0" : "1.0");
+            return buffer;
+        }
+    }
+    return std::string();
+}
+
+/// Write the \c _size bytes at \c _data to \c _filename in a single call
+bool write_file(const std::string& _filename, const void* _data, size_t _size)
+{
+    FILE* file = std::fopen(_filename.c_str(), "wb");
+    if (!file) return false;
+    const bool ok = std::fwrite(_data, 1, _size, file) == _size;
+    return (std::fclose(file) == 0) && ok;
+}
+
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Image::map(unsigned int _width, unsigned int _height,
+                const std::string& _filename, Format _format)
+{
+    const std::string head = header(_format, _width, _height, false);
+
+    // the pixels are stored in the file's layout
+    const Storage storage = storage_;
+    resize(0, 0);
+    memory_.shrink_to_fit();
+    width_   = _width;
+    height_  = _height;
+    storage_ = (_format == PFM) ? FLOAT : BYTE;
+    file_.reset(new MappedFile);
+    if (!file_->create(_filename, head.size() + size_t(width_) * height_ * pixel_size()))
+    {
+        storage_ = storage;
+        resize(width_, height_);
+        throw std::runtime_error("Cannot create image " + _filename);
+    }
+    std::memcpy(file_->data(), head.data(), head.size());
+    bgr_      = (_format == TGA);
+    top_down_ = (_format == PPM);
+    offset_   = head.size();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Image::set_tile(unsigned int _x, unsigned int _y,
+                     unsigned int _width, unsigned int _height,
+                     const vec3* _pixels)
+{
+    assert(_x + _width  <= width_);
+    assert(_y + _height <= height_);
+    if (_width == 0 || _height == 0) return;
+
+    for (unsigned int j=0; j<_height; ++j)
+        for (unsigned int i=0; i<_width; ++i)
+            set(_x+i, _y+j, _pixels[size_t(j)*_width + i]);
+
+    // the tile is finished, release its memory. The range between its
+    // first and last row also covers pixels of other tiles, which are
+    // loaded from the file again when they are written.
+    if (file_)
+    {
+        const unsigned char* data  = reinterpret_cast<const unsigned char*>(file_->data());
+        const unsigned char* first = pixel(_x, top_down_ ? _y + _height - 1 : _y);
+        const unsigned char* last  = pixel(_x + _width - 1, top_down_ ? _y : _y + _height - 1) + pixel_size();
+        file_->evict(first - data, last - first);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Image::row_bytes(unsigned int _y, bool _bgr, unsigned char* _bytes) const
+{
+    const unsigned char* p = row(_y);
+    const size_t         n = 3 * size_t(width_);
+
+    if (storage_ == FLOAT)
+    {
+        // a single pass over the channels, which the compiler vectorizes
+        for (size_t i=0; i<n; ++i)
+        {
+            float c;
+            std::memcpy(&c, p + i * sizeof(float), sizeof(float));
+            _bytes[i] = quantize(c);
+        }
+        if (_bgr)
+            for (size_t i=0; i<n; i+=3) std::swap(_bytes[i], _bytes[i+2]);
+    }
+    else
+    {
+        std::memcpy(_bytes, p, n);
+        if (_bgr != bgr_)
+            for (size_t i=0; i<n; i+=3) std::swap(_bytes[i], _bytes[i+2]);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Image::row_floats(unsigned int _y, unsigned char* _floats) const
+{
+    const unsigned char* p = row(_y);
+
+    if (storage_ == FLOAT)
+    {
+        std::memcpy(_floats, p, 3 * sizeof(float) * size_t(width_));
+    }
+    else
+    {
+        const int r = bgr_ ? 2 : 0;
+        for (size_t i=0; i<width_; ++i, p += 3)
+        {
+            const float c[3] = { p[r] / 255.0f, p[1] / 255.0f, p[2-r] / 255.0f };
+            std::memcpy(_floats + i * sizeof(c), c, sizeof(c));
+        }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Image::Format Image::format(const std::string& _filename)
+{
+    const size_t dot = _filename.find_last_of('.');
+    std::string  ext = (dot == std::string::npos) ? "" : _filename.substr(dot + 1);
+    for (char& c: ext) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+
+    if (ext == "tga") return TGA;
+    if (ext == "ppm") return PPM;
+    if (ext == "pfm") return PFM;
+    throw std::runtime_error("Unknown image format of " + _filename + " (use .tga, .ppm, or .pfm)");
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Image::write(const std::string& _filename, Format _format) const
+{
+    const std::string head = header(_format, width_, height_, true);
+    const size_t      n    = size_t(width_) * height_;
+    std::vector<unsigned char> buffer;
+
+    switch (_format)
+    {
+        case TGA:
+        {
+            // the rows are stored bottom-up, each one is converted into a
+            // buffer that stays in cache and run-length encoded from there
+            std::vector<unsigned char> bytes(3 * size_t(width_));
+            const size_t packets = (width_ + MAX_PACKET - 1) / MAX_PACKET;
+            buffer.resize(head.size() + 3 * n + packets * height_);
+            std::memcpy(buffer.data(), head.data(), head.size());
+            unsigned char* out = buffer.data() + head.size();
+            for (unsigned int y=0; y<height_; ++y)
+            {
+                row_bytes(y, true, bytes.data());
+                out = encode_rle(bytes.data(), width_, out);
+            }
+            buffer.resize(out - buffer.data());
+            break;
+        }
+
+        case PPM:
+        {
+            // the rows are stored top-down
+            buffer.resize(head.size() + 3 * n);
+            std::memcpy(buffer.data(), head.data(), head.size());
+            for (unsigned int y=0; y<height_; ++y)
+                row_bytes(height_ - 1 - y, false, buffer.data() + head.size() + 3 * size_t(y) * width_);
+            break;
+        }
+
+        case PFM:
+        {
+            // the rows are stored bottom-up
+            const size_t row_size = 3 * sizeof(float) * size_t(width_);
+            buffer.resize(head.size() + row_size * height_);
+            std::memcpy(buffer.data(), head.data(), head.size());
+            for (unsigned int y=0; y<height_; ++y)
+                row_floats(y, buffer.data() + head.size() + row_size * y);
+            break;
+        }
+    }
+
+    return write_file(_filename, buffer.data(), buffer.size());
+}
+
+
+//=============================================================================
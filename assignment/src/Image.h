@@ -14,37 +14,84 @@
 //== INCLUDES =================================================================
 
 #include "vec3.h"
+#include "MappedFile.h"
 #include <vector>
+#include <algorithm>
 #include <assert.h>
-#include <fstream>
+#include <cstring>
+#include <memory>
+#include <string>
 
 
 //== CLASS DEFINITION =========================================================
 
 
 /// \class Image Image.h
-/// This class stores an image as a big array of colors, which are represented
-/// as vec3 values for RGB.
+/// This class stores an image as a big array of RGB colors. The colors are
+/// stored compactly, either as three floats or as three bytes per pixel, and
+/// converted from and to vec3 on access. Pixel (0,0) is the lower left one.
+///
+/// Instead of in memory, the pixels can be stored directly in the output
+/// file (see map()). Then the finished tiles passed to set_tile() are
+/// evicted from memory, such that images larger than the memory can be
+/// rendered.
 class Image
 {
 public:
 
+    /// how the colors of the pixels are stored
+    enum Storage
+    {
+        FLOAT, ///< three 32-bit floats per pixel
+        BYTE   ///< three bytes per pixel, quantized like written images
+    };
+
+    /// file formats supported by write() and map()
+    enum Format
+    {
+        TGA, ///< run-length encoded TGA with 8 bits per channel
+        PPM, ///< binary PPM (P6) with 8 bits per channel
+        PFM  ///< PFM with one 32-bit float per channel, not quantized
+    };
+
     /// Construct an image of size _width times _height
     /// \param _width Width of the image in pixels
     /// \param _height Height of the image in pixels
-    Image(unsigned int _width=0, unsigned int _height=0)
+    /// \param _storage How the colors are stored
+    Image(unsigned int _width=0, unsigned int _height=0, Storage _storage=FLOAT)
+    : storage_(_storage)
     {
         resize(_width, _height);
     }
 
-    /// Resize the image
+    /// Resize the image, which is stored in memory afterwards
     /// \param _width New width of the image in pixels
     /// \param _height New height of the image in pixels
     void resize(unsigned int _width, unsigned int _height)
     {
-        width_  = _width;
-        height_ = _height;
-        pixels_.resize(width_ * height_);
+        file_.reset();
+        width_    = _width;
+        height_   = _height;
+        bgr_      = false;
+        top_down_ = false;
+        offset_   = 0;
+        memory_.assign(size_t(width_) * height_ * pixel_size(), 0);
+    }
+
+    /// Resize the image to _width times _height pixels, which are stored in
+    /// file \c _filename with format \c _format instead of in memory. The
+    /// file is created with the header and size of the image, TGA files
+    /// without run-length encoding. Its pixels are stored in the format's
+    /// layout, i.e., as floats for PFM and as bytes otherwise. The file is
+    /// complete once the image is destroyed or resized. Throws
+    /// std::runtime_error if the file cannot be created.
+    void map(unsigned int _width, unsigned int _height,
+             const std::string& _filename, Format _format);
+
+    /// Are the pixels stored in a file (see map())?
+    bool is_mapped() const
+    {
+        return file_ != nullptr;
     }
 
     /// Returns image width in pixels.
@@ -59,71 +106,139 @@ public:
         return height_;
     }
 
-    /// Read/write access to pixel (_x,_y). Use this to set the color by
-    /// image(x,y) = color;
-    vec3& operator()(unsigned int _x, unsigned int _y)
+    /// Returns how the colors are stored.
+    Storage storage() const
     {
-        assert(_x < width_);
-        assert(_y < height_);
-        return pixels_[_y*static_cast<unsigned int>(width_) + _x];
+        return storage_;
     }
 
     /// Read access to pixel (_x,_y).
-    const vec3& operator()(unsigned int _x, unsigned int _y) const
+    vec3 operator()(unsigned int _x, unsigned int _y) const
     {
-        assert(_x < width_);
-        assert(_y < height_);
-        return pixels_[_y*static_cast<unsigned int>(width_) + _x];
+        const unsigned char* p = pixel(_x, _y);
+        if (storage_ == FLOAT)
+        {
+            float c[3];
+            std::memcpy(c, p, sizeof(c));
+            return vec3(c[0], c[1], c[2]);
+        }
+        const int r = bgr_ ? 2 : 0;
+        return vec3(p[r], p[1], p[2-r]) / Scalar(255);
     }
 
-    /// Writes the image in TGA format to a file.
-    /// \param[in] _filename Filename to save the image to.
-    bool write(const std::string &_filename)
-    {
-        std::ofstream file(_filename, std::fstream::binary);
-        if (!file) return false;
-
-        file.put(0); //id length
-        file.put(0); //no color map
-        file.put(2); //uncompressed image
-        file.put(0); //offset color map table
-        file.put(0); //
-        file.put(0); //number of entries
-        file.put(0); //
-        file.put(0); //bits per pixel
-        file.put(0); //abs coordinate lower left display in x direction
-        file.put(0); //
-        file.put(0); //abs coordinate lower left display in y direction
-        file.put(0); //
-        file.put((width_  & 0x00FF)); //width in pixels
-        file.put((width_  & 0xFF00)/ 256);
-        file.put((height_ & 0x00FF)); //height in pixels
-        file.put((height_ & 0xFF00)/ 256);
-        file.put(24); //bits per pixel
-        file.put(0); //image descriptor
-
-        for (vec3 color: pixels_)
+    /// Set the color of pixel (_x,_y).
+    void set(unsigned int _x, unsigned int _y, const vec3& _color)
+    {
+        unsigned char* p = const_cast<unsigned char*>(pixel(_x, _y));
+        if (storage_ == FLOAT)
         {
-            file.put(static_cast<unsigned char>(255.0 * color[2]));
-            file.put(static_cast<unsigned char>(255.0 * color[1]));
-            file.put(static_cast<unsigned char>(255.0 * color[0]));
+            const float c[3] = { float(_color[0]), float(_color[1]), float(_color[2]) };
+            std::memcpy(p, c, sizeof(c));
+            return;
         }
+        const int r = bgr_ ? 2 : 0;
+        p[r]   = quantize(_color[0]);
+        p[1]   = quantize(_color[1]);
+        p[2-r] = quantize(_color[2]);
+    }
+
+    /// Copy a block of _width x _height pixels, stored row by row in _pixels,
+    /// into the image with its upper left corner at pixel (_x,_y). Evicts
+    /// the block from memory if the image is stored in a file.
+    void set_tile(unsigned int _x, unsigned int _y,
+                  unsigned int _width, unsigned int _height,
+                  const vec3* _pixels);
+
+    /// Returns the maximum width and height of images in format \c _format.
+    static unsigned int max_size(Format _format)
+    {
+        return _format == TGA ? 0xFFFF : 0xFFFFFFFF;
+    }
+
+    /// Returns the format matching the extension of \c _filename (.tga,
+    /// .ppm, or .pfm, in any case). Throws std::runtime_error for other
+    /// extensions.
+    static Format format(const std::string& _filename);
+
+    /// Writes the image to a file. The whole image is converted into a
+    /// buffer first, which is then written with a single call. Throws
+    /// std::runtime_error if the format cannot store the image's size.
+    /// \param[in] _filename Filename to save the image to.
+    /// \param[in] _format File format, see format().
+    /// \return whether the file could be written
+    bool write(const std::string& _filename, Format _format = TGA) const;
+
+    /// Quantize a color channel to 8 bits: clamp it to [0,1] and scale it
+    /// by 255 without rounding.
+    static unsigned char quantize(Scalar _c)
+    {
+        return static_cast<unsigned char>(Scalar(255) * std::min(std::max(_c, Scalar(0)), Scalar(1)));
+    }
+
+
+private:
 
-        file.close();
-        return true;
+    /// bytes per pixel
+    size_t pixel_size() const
+    {
+        return storage_ == FLOAT ? 3 * sizeof(float) : 3;
     }
 
+    /// the first byte of the pixels
+    const unsigned char* pixels() const
+    {
+        const unsigned char* data = file_ ? reinterpret_cast<const unsigned char*>(file_->data())
+                                          : memory_.data();
+        return data + offset_;
+    }
+
+    /// the first byte of row _y
+    const unsigned char* row(unsigned int _y) const
+    {
+        const size_t y = top_down_ ? height_ - 1 - _y : _y;
+        return pixels() + y * width_ * pixel_size();
+    }
+
+    /// the first byte of pixel (_x,_y)
+    const unsigned char* pixel(unsigned int _x, unsigned int _y) const
+    {
+        assert(_x < width_);
+        assert(_y < height_);
+        return row(_y) + _x * pixel_size();
+    }
+
+    /// Convert row _y to 8-bit RGB (or BGR if _bgr) colors in _bytes
+    void row_bytes(unsigned int _y, bool _bgr, unsigned char* _bytes) const;
+
+    /// Convert row _y to float RGB colors in _floats (not necessarily aligned)
+    void row_floats(unsigned int _y, unsigned char* _floats) const;
+
 
 private:
 
-    /// vector with all pixels in the image
-    std::vector<vec3> pixels_;
-    
     /// image width in pixels
-    unsigned short int width_;
-    
+    unsigned int width_ = 0;
+
     /// image height in pixels
-    unsigned short int height_;
+    unsigned int height_ = 0;
+
+    /// how the colors are stored
+    Storage storage_;
+
+    /// are bytes stored in BGR order (instead of RGB)?
+    bool bgr_ = false;
+
+    /// are the rows stored from top to bottom (instead of bottom to top)?
+    bool top_down_ = false;
+
+    /// offset of the pixels in memory_ or the file (e.g. behind its header)
+    size_t offset_ = 0;
+
+    /// the pixels of an image stored in memory
+    std::vector<unsigned char> memory_;
+
+    /// the file storing the pixels, see map()
+    std::unique_ptr<MappedFile> file_;
 };
 
 
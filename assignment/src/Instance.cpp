@@ -0,0 +1,197 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "Instance.h"
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+Instance::Instance(std::istream& is, const Mesh* _mesh)
+: mesh_(_mesh)
+{
+    // start with the identity
+    linear_[0] = inverse_[0] = vec3(1, 0, 0);
+    linear_[1] = inverse_[1] = vec3(0, 1, 0);
+    linear_[2] = inverse_[2] = vec3(0, 0, 1);
+    translation_ = vec3(0, 0, 0);
+
+    // transformations up to the draw mode
+    std::string token;
+    bool        has_mode = false;
+    while (!has_mode && (is >> token))
+    {
+        vec3 linear[3] = { vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1) };
+        vec3 translation(0, 0, 0);
+
+        if (token == "translate")
+        {
+            is >> translation;
+        }
+        else if (token == "scale")
+        {
+            vec3 s;
+            is >> s;
+            for (int i=0; i<3; ++i) linear[i][i] = s[i];
+        }
+        else if (token == "rotate")
+        {
+            vec3   axis;
+            Scalar degrees;
+            is >> axis >> degrees;
+            const vec3   a = normalize(axis);
+            const Scalar c = std::cos(degrees / 180.0 * M_PI);
+            const Scalar s = std::sin(degrees / 180.0 * M_PI);
+            const Scalar x = a[0], y = a[1], z = a[2];
+            linear[0] = vec3(c + x*x*(1-c),   x*y*(1-c) - z*s, x*z*(1-c) + y*s);
+            linear[1] = vec3(y*x*(1-c) + z*s, c + y*y*(1-c),   y*z*(1-c) - x*s);
+            linear[2] = vec3(z*x*(1-c) - y*s, z*y*(1-c) + x*s, c + z*z*(1-c));
+        }
+        else if (token == "matrix")
+        {
+            for (int i=0; i<3; ++i)
+                is >> linear[i][0] >> linear[i][1] >> linear[i][2] >> translation[i];
+        }
+        else
+        {
+            draw_mode_ = Mesh::parse_draw_mode(token);
+            has_mode   = true;
+            continue;
+        }
+
+        if (!is) throw std::runtime_error("Invalid instance transformation " + token);
+        append(linear, translation);
+    }
+
+    if (!has_mode) throw std::runtime_error("Instance without draw mode");
+    is >> material;
+
+    // the inverse of the linear part (rows), computed from the cross
+    // products of its rows, which are the columns of the inverse
+    const vec3   c0  = cross(linear_[1], linear_[2]);
+    const vec3   c1  = cross(linear_[2], linear_[0]);
+    const vec3   c2  = cross(linear_[0], linear_[1]);
+    const Scalar det = dot(linear_[0], c0);
+    if (std::abs(det) <= std::numeric_limits<Scalar>::min())
+        throw std::runtime_error("Instance transformation is not invertible");
+    for (int i=0; i<3; ++i)
+        inverse_[i] = vec3(c0[i], c1[i], c2[i]) / det;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Instance::append(const vec3 _linear[3], const vec3& _translation)
+{
+    // the new transformation is applied after the current one:
+    // x -> L (A x + b) + t
+    vec3 linear[3];
+    for (int i=0; i<3; ++i)
+    {
+        linear[i] = _linear[i][0] * linear_[0] + _linear[i][1] * linear_[1] + _linear[i][2] * linear_[2];
+    }
+    const vec3 b = translation_;
+    for (int i=0; i<3; ++i)
+    {
+        linear_[i]      = linear[i];
+        translation_[i] = dot(_linear[i], b) + _translation[i];
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Scalar Instance::to_object(const Ray& _ray, Ray& _object_ray) const
+{
+    const vec3 o = _ray.origin - translation_;
+    const vec3 d = _ray.direction;
+    const vec3 origin   (dot(inverse_[0], o), dot(inverse_[1], o), dot(inverse_[2], o));
+    const vec3 direction(dot(inverse_[0], d), dot(inverse_[1], d), dot(inverse_[2], d));
+
+    // the direction is normalized by Ray, which scales the ray parameters
+    const Scalar scale = norm(direction);
+    const Scalar tmax  = (_ray.tmax < std::numeric_limits<Scalar>::max() / scale)
+                       ? _ray.tmax * scale : std::numeric_limits<Scalar>::max();
+    _object_ray = Ray(origin, direction, _ray.tmin * scale, tmax);
+    return scale;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Instance::intersect(const Ray& _ray,
+                         vec3&      _intersection_point,
+                         vec3&      _intersection_normal,
+                         Scalar&    _intersection_t) const
+{
+    Ray          ray;
+    const Scalar scale = to_object(_ray, ray);
+
+    vec3   point, normal;
+    Scalar t;
+    if (!mesh_->intersect(ray, draw_mode_, point, normal, t))
+    {
+        _intersection_t = NO_INTERSECTION;
+        return false;
+    }
+
+    // normals are transformed by the transposed inverse
+    _intersection_t      = t / scale;
+    _intersection_point  = _ray(_intersection_t);
+    _intersection_normal = normalize(normal[0] * inverse_[0] + normal[1] * inverse_[1] + normal[2] * inverse_[2]);
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Instance::occluded(const Ray& _ray) const
+{
+    Ray ray;
+    to_object(_ray, ray);
+    return mesh_->occluded(ray);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Instance::bounds(vec3& _bb_min, vec3& _bb_max) const
+{
+    vec3 mesh_min, mesh_max;
+    if (!mesh_->bounds(mesh_min, mesh_max)) return false;
+
+    // bounding box of the transformed corners of the mesh's box
+    _bb_min = vec3(std::numeric_limits<Scalar>::max());
+    _bb_max = vec3(std::numeric_limits<Scalar>::lowest());
+    for (int c=0; c<8; ++c)
+    {
+        const vec3 corner((c & 1) ? mesh_max[0] : mesh_min[0],
+                          (c & 2) ? mesh_max[1] : mesh_min[1],
+                          (c & 4) ? mesh_max[2] : mesh_min[2]);
+        const vec3 p = vec3(dot(linear_[0], corner), dot(linear_[1], corner), dot(linear_[2], corner)) + translation_;
+        _bb_min = min(_bb_min, p);
+        _bb_max = max(_bb_max, p);
+    }
+    return true;
+}
+
+
+//=============================================================================
@@ -0,0 +1,91 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+
+//== INCLUDES =================================================================
+
+#include "Object.h"
+#include "Mesh.h"
+#include "vec3.h"
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class Instance Instance.h
+/// This class places a mesh in the scene with an affine transformation and
+/// its own material and draw mode. Rays are transformed into the mesh's
+/// coordinate system and intersected with the mesh there, such that all
+/// instances share the mesh's triangles and acceleration structure. An
+/// instance itself only stores its transformation and material.
+class Instance : public Object
+{
+public:
+
+    /// Construct an instance of \c _mesh, parsing its transformation, draw
+    /// mode, and material from an input stream. The transformation is a
+    /// sequence of `translate x y z`, `rotate x y z degrees` (about the axis
+    /// (x,y,z) through the origin), `scale x y z`, and `matrix` followed by
+    /// the 12 entries of a 3x4 matrix (row by row), which are applied to the
+    /// mesh in the given order. The mesh has to outlive the instance.
+    Instance(std::istream& is, const Mesh* _mesh);
+
+    /// Intersect the instance with \c _ray by intersecting the mesh with the
+    /// ray transformed into the mesh's coordinate system.
+    /// This function overrides Object::intersect().
+    virtual bool intersect(const Ray& _ray,
+                           vec3&      _intersection_point,
+                           vec3&      _intersection_normal,
+                           Scalar&    _intersection_t) const override;
+
+    /// Does \c _ray hit the instance within its interval?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray) const override;
+
+    /// Compute the bounding box of the transformed mesh's bounding box.
+    /// This function overrides Object::bounds().
+    virtual bool bounds(vec3& _bb_min, vec3& _bb_max) const override;
+
+private:
+
+    /// Append the transformation with linear part \c _linear (rows) and
+    /// translation \c _translation to the current one.
+    void append(const vec3 _linear[3], const vec3& _translation);
+
+    /// Transform \c _ray into the mesh's coordinate system. Its parameters
+    /// are scaled by the returned factor, which converts mesh ray parameters
+    /// back by division.
+    Scalar to_object(const Ray& _ray, Ray& _object_ray) const;
+
+private:
+
+    /// the instantiated mesh
+    const Mesh* mesh_;
+
+    /// shade with flat or Phong shading?
+    Mesh::Draw_mode draw_mode_;
+
+    /// rows of the linear part of the transformation from mesh to world
+    vec3 linear_[3];
+
+    /// translation of the transformation from mesh to world
+    vec3 translation_;
+
+    /// rows of the inverse of linear_
+    vec3 inverse_[3];
+};
+
+
+//=============================================================================
+#endif // INSTANCE_H defined
+//=============================================================================
@@ -0,0 +1,209 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "MappedFile.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+bool MappedFile::open(const std::string& _filename)
+{
+    close();
+
+#ifdef _WIN32
+
+    HANDLE file = CreateFileA(_filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    FILETIME      time;
+    if (!GetFileSizeEx(file, &size) || !GetFileTime(file, nullptr, nullptr, &time))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    size_  = static_cast<size_t>(size.QuadPart);
+    // file times count 100ns intervals since 1601
+    mtime_ = static_cast<int64_t>((uint64_t(time.dwHighDateTime) << 32 | time.dwLowDateTime) / 10000000ull)
+           - 11644473600ll;
+
+    if (size_ > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void*  data    = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!data)
+        {
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        mapping_ = mapping;
+        data_    = static_cast<char*>(data);
+    }
+    file_ = file;
+
+#else
+
+    const int fd = ::open(_filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        ::close(fd);
+        return false;
+    }
+    size_  = static_cast<size_t>(st.st_size);
+    mtime_ = static_cast<int64_t>(st.st_mtime);
+
+    if (size_ > 0)
+    {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        data_ = static_cast<char*>(data);
+    }
+
+    // the mapping stays valid after closing the file
+    ::close(fd);
+
+#endif
+
+    open_ = true;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool MappedFile::create(const std::string& _filename, size_t _size)
+{
+    close();
+
+#ifdef _WIN32
+
+    HANDLE file = CreateFileA(_filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    if (_size > 0)
+    {
+        // the mapping extends the file to its size
+        const uint64_t size    = _size;
+        HANDLE         mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE,
+                                                    DWORD(size >> 32), DWORD(size & 0xFFFFFFFF), nullptr);
+        void*          data    = mapping ? MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+        if (!data)
+        {
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        mapping_ = mapping;
+        data_    = static_cast<char*>(data);
+    }
+    file_ = file;
+
+#else
+
+    const int fd = ::open(_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    if (_size > 0)
+    {
+        void* data = (ftruncate(fd, static_cast<off_t>(_size)) == 0)
+                   ? mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                   : MAP_FAILED;
+        if (data == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        data_ = static_cast<char*>(data);
+    }
+
+    // the mapping stays valid after closing the file
+    ::close(fd);
+
+#endif
+
+    size_ = _size;
+    open_ = true;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void MappedFile::evict(size_t _offset, size_t _size)
+{
+    if (!data_ || _offset >= size_) return;
+    _size = std::min(_size, size_ - _offset);
+
+#ifdef _WIN32
+    // writes the pages back, Windows trims them from the working set
+    // when memory gets short
+    FlushViewOfFile(data_ + _offset, _size);
+#else
+    // whole pages only, starting at a page boundary. Dropping the pages of
+    // a shared file mapping keeps their (possibly modified) contents in
+    // the file, also for the parts of the pages outside the range.
+    static const size_t page  = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t        begin = _offset / page * page;
+    const size_t        end   = std::min(size_, (_offset + _size + page - 1) / page * page);
+    msync(data_ + begin, end - begin, MS_ASYNC);
+    madvise(data_ + begin, end - begin, MADV_DONTNEED);
+#endif
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void MappedFile::close()
+{
+    if (!open_) return;
+
+#ifdef _WIN32
+    if (data_)    UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_)    CloseHandle(file_);
+    mapping_ = file_ = nullptr;
+#else
+    if (data_) munmap(data_, size_);
+#endif
+
+    open_  = false;
+    data_  = nullptr;
+    size_  = 0;
+    mtime_ = 0;
+}
+
+
+//=============================================================================
@@ -0,0 +1,106 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+
+//== INCLUDES =================================================================
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class MappedFile MappedFile.h
+/// This class maps a file read-only into memory, such that its contents can
+/// be accessed like an array without copying them into a buffer first. The
+/// operating system loads the pages on first access and shares them between
+/// processes. The mapping is released by the destructor. Files created by
+/// create() are mapped writable instead, such that data can be stored in
+/// them without holding all of it in memory.
+class MappedFile
+{
+public:
+
+    /// Construct without file, see open().
+    MappedFile() {}
+
+    /// Map file \c _filename, see open().
+    explicit MappedFile(const std::string& _filename) { open(_filename); }
+
+    /// Unmap the file.
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Map file \c _filename (after unmapping the current one). Returns
+    /// false if it cannot be opened or mapped. Empty files are valid and
+    /// have no data().
+    bool open(const std::string& _filename);
+
+    /// Create (or truncate) file \c _filename with \c _size bytes and map
+    /// it writable (after unmapping the current one). Returns false if it
+    /// cannot be created or mapped.
+    bool create(const std::string& _filename, size_t _size);
+
+    /// Release the memory of the bytes [_offset, _offset + _size) of a file
+    /// mapped by create(). Their contents stay in the file and are loaded
+    /// again when accessed. This bounds the memory of files that are
+    /// written piece by piece.
+    void evict(size_t _offset, size_t _size);
+
+    /// Unmap the current file.
+    void close();
+
+    /// Is a file mapped?
+    bool is_open() const { return open_; }
+
+    /// first byte of the file (nullptr for empty files)
+    const char* data() const { return data_; }
+
+    /// first byte of the file, writable for files mapped by create()
+    char* data() { return data_; }
+
+    /// size of the file in bytes
+    size_t size() const { return size_; }
+
+    /// last modification time of the file (in seconds since the epoch)
+    int64_t mtime() const { return mtime_; }
+
+private:
+
+    /// is a file mapped?
+    bool open_ = false;
+
+    /// the mapped file contents
+    char* data_ = nullptr;
+
+    /// the size of the file in bytes
+    size_t size_ = 0;
+
+    /// the modification time of the file
+    int64_t mtime_ = 0;
+
+#ifdef _WIN32
+    /// handles of the file and its mapping
+    void* file_    = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
+
+
+//=============================================================================
+#endif // MAPPEDFILE_H defined
+//=============================================================================
@@ -34,10 +34,10 @@ struct Material
     vec3   specular;
 
     /// shininess factor
-    double shininess;
+    Scalar shininess;
 
     /// reflectivity factor (1=perfect mirror, 0=no reflection).
-    double mirror;
+    Scalar mirror;
 };
 
 
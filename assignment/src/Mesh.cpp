@@ -11,11 +11,124 @@
 //== INCLUDES =================================================================
 
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "OffReader.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <string>
 #include <stdexcept>
 #include <limits>
 #include <cmath>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#endif
+
+
+//== SIMD HELPERS =============================================================
+
+
+#if defined(__AVX2__)
+namespace {
+
+// thin wrappers that pick the 256-bit AVX instructions for the Scalar type,
+// such that one register holds the BLOCK_SIZE lanes of a Triangle_block
+#if RAYTRACE_FLOAT
+typedef __m256 simd;
+inline simd simd_zero()                     { return _mm256_setzero_ps(); }
+inline simd simd_set1(float _s)             { return _mm256_set1_ps(_s); }
+inline simd simd_load(const float* _p)      { return _mm256_load_ps(_p); }
+inline void simd_store(float* _p, simd _a)  { _mm256_storeu_ps(_p, _a); }
+inline simd simd_add(simd _a, simd _b)      { return _mm256_add_ps(_a, _b); }
+inline simd simd_sub(simd _a, simd _b)      { return _mm256_sub_ps(_a, _b); }
+inline simd simd_mul(simd _a, simd _b)      { return _mm256_mul_ps(_a, _b); }
+inline simd simd_div(simd _a, simd _b)      { return _mm256_div_ps(_a, _b); }
+inline simd simd_and(simd _a, simd _b)      { return _mm256_and_ps(_a, _b); }
+inline int  simd_movemask(simd _a)          { return _mm256_movemask_ps(_a); }
+template <int CMP> inline simd simd_cmp(simd _a, simd _b) { return _mm256_cmp_ps(_a, _b, CMP); }
+#else
+typedef __m256d simd;
+inline simd simd_zero()                     { return _mm256_setzero_pd(); }
+inline simd simd_set1(double _s)            { return _mm256_set1_pd(_s); }
+inline simd simd_load(const double* _p)     { return _mm256_load_pd(_p); }
+inline void simd_store(double* _p, simd _a) { _mm256_storeu_pd(_p, _a); }
+inline simd simd_add(simd _a, simd _b)      { return _mm256_add_pd(_a, _b); }
+inline simd simd_sub(simd _a, simd _b)      { return _mm256_sub_pd(_a, _b); }
+inline simd simd_mul(simd _a, simd _b)      { return _mm256_mul_pd(_a, _b); }
+inline simd simd_div(simd _a, simd _b)      { return _mm256_div_pd(_a, _b); }
+inline simd simd_and(simd _a, simd _b)      { return _mm256_and_pd(_a, _b); }
+inline int  simd_movemask(simd _a)          { return _mm256_movemask_pd(_a); }
+template <int CMP> inline simd simd_cmp(simd _a, simd _b) { return _mm256_cmp_pd(_a, _b, CMP); }
+#endif
+
+}
+#endif
+
+
+//== MESH CACHE ===============================================================
+
+
+namespace {
+
+/// first bytes of a mesh cache file
+constexpr char CACHE_MAGIC[8] = { 'R', 'T', 'M', 'E', 'S', 'H', 'C', '\0' };
+
+/// version of the cache format, to be increased whenever the cached data
+/// or its layout changes
+constexpr uint32_t CACHE_VERSION = 4;
+
+/// arrays in a cache file start at multiples of this (at least the
+/// alignment of Mesh::Triangle_block)
+constexpr size_t CACHE_ALIGNMENT = 64;
+
+/// the header of a mesh cache file, followed by the arrays of vertices,
+/// triangles, intersection records, BVH nodes, BVH indices, triangle
+/// blocks, and leaf blocks, each starting at a multiple of CACHE_ALIGNMENT
+struct Cache_header
+{
+    char     magic[8];
+    uint32_t version;
+    /// sizes of Scalar, Vertex, Triangle, Triangle_record, BVH::Node,
+    /// and Triangle_block, which change with the build configuration
+    uint32_t sizes[6];
+    /// the key of the OFF file the cache was built from
+    uint64_t source_size;
+    int64_t  source_mtime;
+    uint64_t source_hash;
+    /// number of entries of the arrays
+    uint64_t counts[7];
+    /// bounding box of the mesh
+    Scalar   bb_min[3], bb_max[3];
+};
+
+/// round \c _offset up to the next multiple of CACHE_ALIGNMENT
+size_t cache_align(size_t _offset)
+{
+    return (_offset + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+}
+
+/// 64 bit hash of \c _size bytes at \c _data, processing 8 bytes at a time
+uint64_t hash_bytes(const char* _data, size_t _size)
+{
+    uint64_t h = 0xcbf29ce484222325ull ^ _size;
+    size_t   i = 0;
+    for (; i+8 <= _size; i+=8)
+    {
+        uint64_t w;
+        std::memcpy(&w, _data+i, 8);
+        h = (h ^ w) * 0x100000001b3ull;
+        h ^= h >> 29;
+    }
+    for (; i<_size; ++i)
+        h = (h ^ static_cast<unsigned char>(_data[i])) * 0x100000001b3ull;
+    return h ^ (h >> 32);
+}
+
+}
 
 
 //== IMPLEMENTATION ===========================================================
@@ -26,6 +139,30 @@ Mesh::Mesh(std::istream &is, const std::string &scenePath)
     std::string meshFile, mode;
     is >> meshFile;
 
+    // the mesh is loaded from this file by load()
+    filename_ = resolve_path(meshFile, scenePath);
+
+    is >> mode;
+    draw_mode_ = parse_draw_mode(mode);
+
+    is >> material;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Mesh::Mesh(const std::string& _filename)
+: filename_(_filename), draw_mode_(PHONG)
+{
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+std::string Mesh::resolve_path(const std::string& _meshFile, const std::string& _scenePath)
+{
     const char pathSep =
 #ifdef _WIN32
                             '\\';
@@ -33,82 +170,261 @@ Mesh::Mesh(std::istream &is, const std::string &scenePath)
                             '/';
 #endif
 
-    // load mesh from file
-    read(scenePath.substr(0, scenePath.find_last_of(pathSep) + 1) + meshFile);
+    return _scenePath.substr(0, _scenePath.find_last_of(pathSep) + 1) + _meshFile;
+}
 
-    is >> mode;
-    if      (mode ==  "FLAT") draw_mode_ = FLAT;
-    else if (mode == "PHONG") draw_mode_ = PHONG;
-    else throw std::runtime_error("Invalid draw mode " + mode);
 
-    is >> material;
+//-----------------------------------------------------------------------------
+
+
+Mesh::Draw_mode Mesh::parse_draw_mode(const std::string& _mode)
+{
+    if      (_mode ==  "FLAT") return FLAT;
+    else if (_mode == "PHONG") return PHONG;
+    else throw std::runtime_error("Invalid draw mode " + _mode);
 }
 
 
 //-----------------------------------------------------------------------------
 
 
-bool Mesh::read(const std::string &_filename)
+void Mesh::read(const std::string &_filename)
 {
+    compact_ = false;
+    std::vector<Compact_vertex>().swap(compact_vertices_);
+    std::vector<uint32_t>().swap(indices_);
+    records_.clear();
+
+    MappedFile file(_filename);
+    if (!file.is_open())
+        throw std::runtime_error("Cannot open mesh " + _filename);
+
+    // use the cache if it was built from the current contents of the file
+    Cache_key key = {};
+    const std::string cache = cache_path(_filename);
+    if (!cache.empty())
+    {
+        key = Cache_key{ file.size(), file.mtime(), hash_bytes(file.data(), file.size()) };
+        if (read_cache(cache, key))
+        {
+            cached_ = true;
+            return;
+        }
+    }
+
+
     // read a mesh in OFF format
+    std::vector<vec3>         positions;
+    std::vector<unsigned int> indices;
+    OffReader::parse(_filename, file.data(), file.size(), positions, indices);
+    file.close();
 
+    vertices_.resize(positions.size());
+    for (size_t i=0; i<positions.size(); ++i)
+        vertices_[i].position = positions[i];
 
-    // open file
-    std::ifstream ifs(_filename);
-    if (!ifs)
+    triangles_.resize(indices.size() / 3);
+    for (size_t i=0; i<triangles_.size(); ++i)
     {
-        std::cerr << "Can't open " << _filename << "\n";
-        return false;
+        triangles_[i].i0 = indices[3*i  ];
+        triangles_[i].i1 = indices[3*i+1];
+        triangles_[i].i2 = indices[3*i+2];
     }
+    cached_ = false;
 
 
-    // read OFF header
-    std::string s;
-    unsigned int nV, nF, dummy, i;
-    ifs >> s;
-    if (s != "OFF")
-    {
-        std::cerr << "No OFF file\n";
+    // compute face and vertex normals
+    compute_normals();
+
+    // compute bounding box
+    compute_bounding_box();
+
+    // precompute intersection data
+    compute_triangle_records();
+
+    // (re)build acceleration structure
+    bvh_  = BVH();
+    grid_ = Grid();
+    set_acceleration(acceleration_);
+
+    // store everything computed above for the next run
+    if (!cache.empty() && key.size)
+        write_cache(cache, key);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+std::string Mesh::cache_path(const std::string& _filename)
+{
+    const std::string suffix = (sizeof(Scalar) == sizeof(float)) ? ".f32.cache" : ".f64.cache";
+
+    const char* dir = std::getenv("RAYTRACE_MESH_CACHE");
+    if (!dir || !*dir)
+        return _filename + suffix;
+    if (std::string(dir) == "off")
+        return std::string();
+
+    // meshes of the same name in different directories must not share a
+    // cache file, so the name includes a hash of the path
+    const std::string::size_type sep = _filename.find_last_of("/\\");
+    const std::string name = (sep == std::string::npos) ? _filename : _filename.substr(sep+1);
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx",
+                  static_cast<unsigned long long>(hash_bytes(_filename.data(), _filename.size())));
+    return std::string(dir) + "/" + name + "." + hash + suffix;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::read_cache(const std::string& _cache, const Cache_key& _key)
+{
+    static_assert(std::is_trivially_copyable<Vertex>::value &&
+                  std::is_trivially_copyable<Triangle>::value &&
+                  std::is_trivially_copyable<Triangle_record>::value &&
+                  std::is_trivially_copyable<BVH::Node>::value &&
+                  std::is_trivially_copyable<Triangle_block>::value,
+                  "cached mesh data must be trivially copyable");
+
+    MappedFile file(_cache);
+    if (!file.is_open() || file.size() < sizeof(Cache_header))
         return false;
-    }
-    ifs >> nV >> nF >> dummy;
-    std::cout << "\n  read " << _filename << ": " << nV << " vertices, " << nF << " triangles";
 
+    Cache_header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    const uint32_t sizes[6] = { sizeof(Scalar), sizeof(Vertex), sizeof(Triangle), sizeof(Triangle_record),
+                                sizeof(BVH::Node), sizeof(Triangle_block) };
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header.version != CACHE_VERSION ||
+        std::memcmp(header.sizes, sizes, sizeof(sizes)) != 0 ||
+        header.source_size  != _key.size  ||
+        header.source_mtime != _key.mtime ||
+        header.source_hash  != _key.hash)
+        return false;
 
-    // read vertices
-    Vertex v;
-    vertices_.clear();
-    vertices_.reserve(nV);
-    for (i=0; i<nV; ++i)
+    // check that all arrays lie within the file before touching them
+    size_t offset = cache_align(sizeof(Cache_header));
+    size_t offsets[7];
+    const size_t entry_sizes[7] = { sizeof(Vertex), sizeof(Triangle), sizeof(Triangle_record),
+                                    sizeof(BVH::Node), sizeof(unsigned int),
+                                    sizeof(Triangle_block), sizeof(unsigned int) };
+    for (int a=0; a<7; ++a)
     {
-        ifs >> v.position;
-        vertices_.push_back(v);
+        if (header.counts[a] > (file.size() - offset) / entry_sizes[a])
+            return false;
+        offsets[a] = offset;
+        offset = cache_align(offset + header.counts[a] * entry_sizes[a]);
     }
 
-
-    // read triangles
-    Triangle t;
-    triangles_.clear();
-    triangles_.reserve(nF);
-    for (i=0; i<nF; ++i)
+    // copy an array in one go
+    auto load = [&](int _a, auto& _vector)
     {
-        ifs >> dummy >> t.i0 >> t.i1 >> t.i2;
-        triangles_.push_back(t);
+        typedef typename std::decay<decltype(_vector)>::type::value_type T;
+        const T* first = reinterpret_cast<const T*>(file.data() + offsets[_a]);
+        _vector.assign(first, first + header.counts[_a]);
+    };
+
+    load(0, vertices_);
+    load(1, triangles_);
+    load(2, records_);
+    if (acceleration_ == ACCEL_BVH)
+    {
+        std::vector<BVH::Node> nodes;
+        std::vector<unsigned int> indices;
+        load(3, nodes);
+        load(4, indices);
+        bvh_.assign(std::move(nodes), std::move(indices));
+        load(5, blocks_);
+        load(6, leaf_blocks_);
     }
 
+    bb_min_ = vec3(header.bb_min[0], header.bb_min[1], header.bb_min[2]);
+    bb_max_ = vec3(header.bb_max[0], header.bb_max[1], header.bb_max[2]);
 
-    // close file
-    ifs.close();
+    // build the grid if it is used instead of the cached BVH, which is
+    // not loaded then
+    grid_ = Grid();
+    set_acceleration(acceleration_);
 
+    return true;
+}
 
-    // compute face and vertex normals
-    compute_normals();
 
-    // compute bounding box
-    compute_bounding_box();
+//-----------------------------------------------------------------------------
 
 
-    return true;
+void Mesh::write_cache(const std::string& _cache, const Cache_key& _key) const
+{
+    // without a BVH (e.g., if a grid is used), the cache would be incomplete
+    if (bvh_.empty()) return;
+
+    Cache_header header = {};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    const uint32_t sizes[6] = { sizeof(Scalar), sizeof(Vertex), sizeof(Triangle), sizeof(Triangle_record),
+                                sizeof(BVH::Node), sizeof(Triangle_block) };
+    std::memcpy(header.sizes, sizes, sizeof(sizes));
+    header.source_size  = _key.size;
+    header.source_mtime = _key.mtime;
+    header.source_hash  = _key.hash;
+    for (int j=0; j<3; ++j)
+    {
+        header.bb_min[j] = bb_min_[j];
+        header.bb_max[j] = bb_max_[j];
+    }
+
+    const void*  arrays[7] = { vertices_.data(), triangles_.data(), records_.data(),
+                               bvh_.nodes().data(), bvh_.indices().data(),
+                               blocks_.data(), leaf_blocks_.data() };
+    const size_t bytes[7]  = { vertices_.size()       * sizeof(Vertex),
+                               triangles_.size()      * sizeof(Triangle),
+                               records_.size()        * sizeof(Triangle_record),
+                               bvh_.nodes().size()    * sizeof(BVH::Node),
+                               bvh_.indices().size()  * sizeof(unsigned int),
+                               blocks_.size()         * sizeof(Triangle_block),
+                               leaf_blocks_.size()    * sizeof(unsigned int) };
+    const size_t counts[7] = { vertices_.size(), triangles_.size(), records_.size(),
+                               bvh_.nodes().size(), bvh_.indices().size(),
+                               blocks_.size(), leaf_blocks_.size() };
+    for (int a=0; a<7; ++a)
+        header.counts[a] = counts[a];
+
+    // write to a temporary file first, such that concurrent readers never
+    // see a partially written cache
+    const std::string tmp = _cache + ".tmp" +
+        std::to_string(std::chrono::steady_clock::now().time_since_epoch().count() ^
+                       reinterpret_cast<uintptr_t>(this));
+    {
+        std::ofstream ofs(tmp, std::ios::binary);
+        if (!ofs) return;
+
+        const char padding[CACHE_ALIGNMENT] = {};
+        size_t offset = sizeof(header);
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (int a=0; a<7; ++a)
+        {
+            ofs.write(padding, cache_align(offset) - offset);
+            offset = cache_align(offset);
+            ofs.write(static_cast<const char*>(arrays[a]), bytes[a]);
+            offset += bytes[a];
+        }
+        if (!ofs)
+        {
+            ofs.close();
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+
+#ifdef _WIN32
+    // rename() does not replace existing files on Windows
+    std::remove(_cache.c_str());
+#endif
+    if (std::rename(tmp.c_str(), _cache.c_str()) != 0)
+        std::remove(tmp.c_str());
 }
 
 
@@ -121,14 +437,14 @@ bool Mesh::read(const std::string &_filename)
 // \param[in] p0, p1, p2    triangle vertex positions
 // \param[out] w0, w1, w2    weights to be used for vertices 0, 1, and 2
 void angleWeights(const vec3 &p0, const vec3 &p1, const vec3 &p2,
-                  double &w0, double &w1, double &w2) {
+                  Scalar &w0, Scalar &w1, Scalar &w2) {
     // compute angle weights
     const vec3 e01 = normalize(p1-p0);
     const vec3 e12 = normalize(p2-p1);
     const vec3 e20 = normalize(p0-p2);
-    w0 = acos( std::max(-1.0, std::min(1.0, dot(e01, -e20) )));
-    w1 = acos( std::max(-1.0, std::min(1.0, dot(e12, -e01) )));
-    w2 = acos( std::max(-1.0, std::min(1.0, dot(e20, -e12) )));
+    w0 = acos( std::max(Scalar(-1), std::min(Scalar(1), dot(e01, -e20) )));
+    w1 = acos( std::max(Scalar(-1), std::min(Scalar(1), dot(e12, -e01) )));
+    w2 = acos( std::max(Scalar(-1), std::min(Scalar(1), dot(e20, -e12) )));
 }
 
 
@@ -154,7 +470,7 @@ void Mesh::compute_normals()
     for (Triangle& t: triangles_)
     {
         //vertices_[t.i0].normal += angleWeights(t.i0, t.i1) * t.normal ;
-        double w0, w1, w2;
+        Scalar w0, w1, w2;
         angleWeights(vertices_[t.i0].position, vertices_[t.i1].position, vertices_[t.i2].position, w0, w1, w2);
         vertices_[t.i0].normal += w0 * t.normal;
         vertices_[t.i1].normal += w1 * t.normal;
@@ -182,8 +498,8 @@ void Mesh::compute_normals()
 
 void Mesh::compute_bounding_box()
 {
-    bb_min_ = vec3(std::numeric_limits<double>::max());
-    bb_max_ = vec3(std::numeric_limits<double>::lowest());
+    bb_min_ = vec3(std::numeric_limits<Scalar>::max());
+    bb_max_ = vec3(std::numeric_limits<Scalar>::lowest());
 
     for (Vertex v: vertices_)
     {
@@ -195,146 +511,271 @@ void Mesh::compute_bounding_box()
 
 //-----------------------------------------------------------------------------
 
-double determinant3x3(std::vector<vec3> matrix) {
-    double a = matrix[0][0], b = matrix[0][1], c = matrix[0][2];
-    double d = matrix[1][0], e = matrix[1][1], f = matrix[1][2];
-    double g = matrix[2][0], h = matrix[2][1], i = matrix[2][2];
 
-    // Apply the determinant formula for 3x3 matrix
-    return a * (e * i - f * h) - b * (d * i - f * g) + c * (d * h - e * g);
+void Mesh::compute_triangle_records()
+{
+    records_.resize(num_triangles());
+    for (unsigned int i=0; i<records_.size(); ++i)
+    {
+        vec3 p0, p1, p2;
+        triangle_positions(i, p0, p1, p2);
+        records_[i].origin = p2;
+        records_[i].edge0  = p0 - p2;
+        records_[i].edge1  = p1 - p2;
+    }
 }
 
-bool Mesh::intersect_bounding_box(const Ray& _ray) const
-{
-    /* PLEASE REFER TO THE intersect_bounding_box.pdf FILE
-     * TO UNDERSTAND THE LOGIC OF THIS METHOD.
-     */
 
-    //**START Initialization:**
-    //Axis of the box
-    const vec3 x = normalize(vec3(1,0,0));
-    const vec3 y = normalize(vec3(0,1,0));
-    const vec3 z = normalize(vec3(0,0,1));
-
-    //Useful vertices
-    const vec3 A = bb_min_;
-    const vec3 G = bb_max_;
-    const vec3 v = G - A;
-
-    //Vectors to represent the important edges of the bounding box
-    const vec3 e = dot(v,z) * z;
-    const vec3 w = v - e;
-    const vec3 d = dot(w,x) * x;
-    const vec3 p = (A + w) - (A + d);
-
-    //Ray
-    const vec3 a = _ray.direction;
-    const vec3 o = _ray.origin;
-
-    //**END Initialization**
-
-    //Things needed for Cramer's Rule
-    const std::vector<vec3> mat_xz = {x, z, a};
-    const std::vector<vec3> mat_yz = {y, z, a};
-    const std::vector<vec3> mat_xy = {x, y, a};
-    const vec3 sost_A = o - A;
-    const vec3 sost_B = o - G;
-    const double det_xz = determinant3x3(mat_xz);
-    const double det_yz = determinant3x3(mat_yz);
-    const double det_xy = determinant3x3(mat_xy);
-
-    //Checks if there is an intersection with the planes generated by the faces of the bounding box.
-    //Checks if the intersection is inside the area of the faces of the bounding box.
-    if (det_xz != 0)
-    {
-        // Planes 1 and 5
-
-        //Plane 1:
-        const double mu_1 = determinant3x3({sost_A,z,a}) / det_xz;
-        const double lambda_1 = determinant3x3({x,sost_A,a}) / det_xz;
-        const double t_1 = ((-1) * determinant3x3({x,z,sost_A})) / det_xz;
-
-        if (0 <= mu_1 && mu_1 <= norm(d) && 0 <= lambda_1 && lambda_1 <= norm(e) && 0 <= t_1)
-        {
-            return true;
-        }
+//-----------------------------------------------------------------------------
 
-        //Plane 5:
-        const double mu_2 = determinant3x3({sost_B,z,a}) / det_xz;
-        const double lambda_2 = determinant3x3({x,sost_B,a}) / det_xz;
-        const double t_2 = ((-1) * determinant3x3({x,z,sost_B})) / det_xz;
 
-        if (0 >= mu_2 && abs(mu_2) <= norm(d) && 0 >= lambda_2 && abs(lambda_2) <= norm(e) && 0 <= t_2)
-        {
-            return true;
-        }
+void Mesh::compact()
+{
+    if (compact_) return;
 
+    // float positions and octahedral normals, 16 bytes per vertex
+    compact_vertices_.resize(vertices_.size());
+    for (size_t i=0; i<vertices_.size(); ++i)
+    {
+        for (int j=0; j<3; ++j)
+            compact_vertices_[i].position[j] = static_cast<float>(vertices_[i].position[j]);
+        compact_vertices_[i].normal = encode_normal(vertices_[i].normal);
     }
 
-    if (det_yz != 0)
+    // three indices per triangle, face normals are recomputed when needed
+    indices_.resize(3 * triangles_.size());
+    for (size_t i=0; i<triangles_.size(); ++i)
     {
-        // Planes 2 and 6
+        indices_[3*i  ] = triangles_[i].i0;
+        indices_[3*i+1] = triangles_[i].i1;
+        indices_[3*i+2] = triangles_[i].i2;
+    }
 
-        //Plane 2:
-        const double mu_1 = determinant3x3({sost_A,z,a}) / det_yz;
-        const double lambda_1 = determinant3x3({y,sost_A,a}) / det_yz;
-        const double t_1 = ((-1) * determinant3x3({y,z,sost_A})) / det_yz;
+    std::vector<Vertex>().swap(vertices_);
+    std::vector<Triangle>().swap(triangles_);
+    compact_ = true;
 
-        if (0 <= mu_1 && mu_1 <= norm(p) && 0 <= lambda_1 && lambda_1 <= norm(e) && 0 <= t_1)
-        {
-            return true;
-        }
+    // the BVH blocks hold copies of the records, which are only needed to
+    // build them (or for the grid)
+    if (acceleration_ == ACCEL_BVH && !bvh_.empty())
+        std::vector<Triangle_record>().swap(records_);
+}
 
-        //Plane 6:
-        const double mu_2 = determinant3x3({sost_B,z,a}) / det_yz;
-        const double lambda_2 = determinant3x3({y,sost_B,a}) / det_yz;
-        const double t_2 = ((-1) * determinant3x3({y,z,sost_B})) / det_yz;
 
-        if (0 >= mu_2 && abs(mu_2) <= norm(p) && 0 >= lambda_2 && abs(lambda_2) <= norm(e) && 0 <= t_2)
-        {
-            return true;
-        }
+//-----------------------------------------------------------------------------
+
+
+size_t Mesh::memory() const
+{
+    return vertices_.capacity()         * sizeof(Vertex)
+         + triangles_.capacity()        * sizeof(Triangle)
+         + compact_vertices_.capacity() * sizeof(Compact_vertex)
+         + indices_.capacity()          * sizeof(uint32_t)
+         + records_.capacity()          * sizeof(Triangle_record)
+         + bvh_.nodes().capacity()      * sizeof(BVH::Node)
+         + bvh_.indices().capacity()    * sizeof(unsigned int)
+         + blocks_.capacity()           * sizeof(Triangle_block)
+         + leaf_blocks_.capacity()      * sizeof(unsigned int)
+         + grid_.memory();
+}
 
+
+//-----------------------------------------------------------------------------
+
+
+void Mesh::triangle_positions(unsigned int _i, vec3& _p0, vec3& _p1, vec3& _p2) const
+{
+    if (compact_)
+    {
+        const uint32_t* t = &indices_[3*_i];
+        const float* p0 = compact_vertices_[t[0]].position;
+        const float* p1 = compact_vertices_[t[1]].position;
+        const float* p2 = compact_vertices_[t[2]].position;
+        _p0 = vec3(p0[0], p0[1], p0[2]);
+        _p1 = vec3(p1[0], p1[1], p1[2]);
+        _p2 = vec3(p2[0], p2[1], p2[2]);
+    }
+    else
+    {
+        const Triangle& t = triangles_[_i];
+        _p0 = vertices_[t.i0].position;
+        _p1 = vertices_[t.i1].position;
+        _p2 = vertices_[t.i2].position;
     }
+}
+
 
-    if (det_xy != 0)
+//-----------------------------------------------------------------------------
+
+
+uint32_t Mesh::encode_normal(const vec3& _n)
+{
+    // project onto the octahedron |x|+|y|+|z| = 1 and unfold its lower
+    // half onto the outer triangles of the square [-1,1]^2
+    const Scalar l1 = std::abs(_n[0]) + std::abs(_n[1]) + std::abs(_n[2]);
+    if (l1 == 0) return 0;
+    Scalar x = _n[0] / l1, y = _n[1] / l1;
+    if (_n[2] < 0)
     {
-        // Planes 3 and 4
+        const Scalar fx = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+        const Scalar fy = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+        x = fx;  y = fy;
+    }
 
-        //Plane 3:
-        const double mu_1 = determinant3x3({sost_A,y,a}) / det_xy;
-        const double lambda_1 = determinant3x3({x,sost_A,a}) / det_xy;
-        const double t_1 = ((-1) * determinant3x3({x,y,sost_A})) / det_xy;
+    // 16 bit signed normalized coordinates
+    auto quantize = [](Scalar _c)
+    {
+        const long q = std::lround(std::max(Scalar(-1), std::min(Scalar(1), _c)) * 32767);
+        return static_cast<uint32_t>(static_cast<uint16_t>(static_cast<int16_t>(q)));
+    };
+    return quantize(x) | (quantize(y) << 16);
+}
 
-        if (0 <= mu_1 && mu_1 <= norm(d) && 0 <= lambda_1 && lambda_1 <= norm(p) && 0 <= t_1)
-        {
-            return true;
-        }
 
-        //Plane 4:
-        const double mu_2 = determinant3x3({sost_B,y,a}) / det_xy;
-        const double lambda_2 = determinant3x3({x,sost_B,a}) / det_xy;
-        const double t_2 = ((-1) * determinant3x3({x,y,sost_B})) / det_xy;
+//-----------------------------------------------------------------------------
+
+
+vec3 Mesh::decode_normal(uint32_t _n)
+{
+    const Scalar x = static_cast<int16_t>(_n & 0xffff) / Scalar(32767);
+    const Scalar y = static_cast<int16_t>(_n >> 16)    / Scalar(32767);
+    vec3 n(x, y, 1 - std::abs(x) - std::abs(y));
+
+    // fold the outer triangles back onto the lower half
+    const Scalar t = std::max(-n[2], Scalar(0));
+    n[0] += (n[0] >= 0) ? -t : t;
+    n[1] += (n[1] >= 0) ? -t : t;
+    return normalize(n);
+}
 
-        if (0 >= mu_2 && abs(mu_2) <= norm(d) && 0 >= lambda_2 && abs(lambda_2) <= norm(p) && 0 <= t_2)
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::bounds(vec3& _bb_min, vec3& _bb_max) const
+{
+    _bb_min = bb_min_;
+    _bb_max = bb_max_;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Mesh::triangle_bounds(std::vector<vec3>& _bb_min, std::vector<vec3>& _bb_max) const
+{
+    _bb_min.resize(num_triangles());
+    _bb_max.resize(num_triangles());
+    for (unsigned int i=0; i<_bb_min.size(); ++i)
+    {
+        vec3 p0, p1, p2;
+        triangle_positions(i, p0, p1, p2);
+        _bb_min[i] = min(p0, min(p1, p2));
+        _bb_max[i] = max(p0, max(p1, p2));
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Mesh::build_bvh()
+{
+    std::vector<vec3> bb_min, bb_max;
+    triangle_bounds(bb_min, bb_max);
+    bvh_.build(bb_min, bb_max, BLOCK_SIZE);
+
+    // pack the triangles of each leaf into blocks of BLOCK_SIZE lanes
+    blocks_.clear();
+    leaf_blocks_.assign(bvh_.nodes().size(), 0);
+    for (size_t n=0; n<bvh_.nodes().size(); ++n)
+    {
+        const BVH::Node& node = bvh_.nodes()[n];
+        if (node.count == 0) continue;
+
+        leaf_blocks_[n] = static_cast<unsigned int>(blocks_.size());
+        for (unsigned int first=0; first<node.count; first+=BLOCK_SIZE)
         {
-            return true;
+            Triangle_block block = {};
+            for (int lane=0; lane<BLOCK_SIZE; ++lane)
+            {
+                // unused lanes repeat the first triangle's index, their
+                // zero edges make the kernel reject them
+                const unsigned int k = first + lane;
+                block.index[lane] = bvh_.primitive(node.offset + (k < node.count ? k : first));
+                if (k >= node.count) continue;
+
+                const Triangle_record& r = records_[block.index[lane]];
+                for (int j=0; j<3; ++j)
+                {
+                    block.origin[j][lane] = r.origin[j];
+                    block.edge0[j][lane]  = r.edge0[j];
+                    block.edge1[j][lane]  = r.edge1[j];
+                }
+            }
+            blocks_.push_back(block);
         }
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Mesh::build_grid()
+{
+    std::vector<vec3> bb_min, bb_max;
+    triangle_bounds(bb_min, bb_max);
+    grid_.build(bb_min, bb_max);
+}
 
+
+//-----------------------------------------------------------------------------
+
+
+void Mesh::set_acceleration(Acceleration _accel)
+{
+    acceleration_ = _accel;
+
+    // a compact mesh may have released its records, see compact()
+    if (records_.empty()) compute_triangle_records();
+
+    if (acceleration_ == ACCEL_GRID)
+    {
+        if (grid_.empty()) build_grid();
+        bvh_ = BVH();
+        blocks_.clear();
+        leaf_blocks_.clear();
+    }
+    else
+    {
+        if (bvh_.empty()) build_bvh();
+        grid_ = Grid();
+        if (compact_) std::vector<Triangle_record>().swap(records_);
     }
+}
 
-    return false; //There is no intersection with the faces of the bounding box
 
+//-----------------------------------------------------------------------------
 
-    /** \todo
-    * Intersect the ray `_ray` with the axis-aligned bounding box of the mesh.
-    * Note that the minimum and maximum point of the bounding box are stored
-    * in the member variables `bb_min_` and `bb_max_`. Return whether the ray
-    * intersects the bounding box.
-    * This function is ued in `Mesh::intersect()` to avoid the intersection test
-    * with all triangles of every mesh in the scene. The bounding boxes are computed
-    * in `Mesh::compute_bounding_box()`.
-    */
+bool Mesh::intersect_bounding_box(const Ray& _ray) const
+{
+    // slab test using the ray's precomputed reciprocal direction
+    Scalar tentry;
+    return BVH::intersect_box(bb_min_, bb_max_, _ray, tentry);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::intersect(const Ray& _ray,
+                     vec3&      _intersection_point,
+                     vec3&      _intersection_normal,
+                     Scalar&    _intersection_t ) const
+{
+    return intersect(_ray, draw_mode_, _intersection_point, _intersection_normal, _intersection_t);
 }
 
 
@@ -342,39 +783,142 @@ bool Mesh::intersect_bounding_box(const Ray& _ray) const
 
 
 bool Mesh::intersect(const Ray& _ray,
+                     Draw_mode  _draw_mode,
                      vec3&      _intersection_point,
                      vec3&      _intersection_normal,
-                     double&    _intersection_t ) const
+                     Scalar&    _intersection_t ) const
 {
-    // check bounding box intersection
-    if (!intersect_bounding_box(_ray))
+    // the closest hit found so far: triangle index and barycentric coordinates
+    unsigned int hit = 0;
+    Scalar       t, alpha, beta, hit_alpha = 0, hit_beta = 0;
+
+    _intersection_t = NO_INTERSECTION;
+
+    // the interval of this copy of the ray shrinks with every closer hit,
+    // such that farther triangles bail out early
+    Ray ray(_ray);
+
+    // traverse the acceleration structure front-to-back. It only visits
+    // triangles in leaves or cells that are hit within the ray's interval,
+    // which replaces the bounding box test of the whole mesh.
+    if (acceleration_ == ACCEL_GRID)
     {
-        return false;
+        grid_.traverse(ray, [&](unsigned int i, Ray& r)
+        {
+            // does ray intersect triangle (closer than previous intersections)?
+            if (hit_triangle(i, r, t, alpha, beta))
+            {
+                r.tmax = _intersection_t = t;
+                hit = i;  hit_alpha = alpha;  hit_beta = beta;
+            }
+        });
+    }
+    else
+    {
+        // BVH leaves are intersected block by block with the SIMD kernel
+        bvh_.traverse_leaves(ray, [&](unsigned int n, Ray& r)
+        {
+            const unsigned int first = leaf_blocks_[n];
+            const unsigned int last  = first + (bvh_.nodes()[n].count + BLOCK_SIZE-1) / BLOCK_SIZE;
+            for (unsigned int b=first; b<last; ++b)
+            {
+                const int lane = hit_block(blocks_[b], r, t, alpha, beta);
+                if (lane >= 0)
+                {
+                    r.tmax = _intersection_t = t;
+                    hit = blocks_[b].index[lane];  hit_alpha = alpha;  hit_beta = beta;
+                }
+            }
+        });
     }
 
-    vec3   p, n;
-    double t;
+    if (_intersection_t == NO_INTERSECTION) return false;
 
-    _intersection_t = NO_INTERSECTION;
+    // compute point and normal only once, for the closest intersection
+    intersection_data(hit, _ray, _intersection_t, hit_alpha, hit_beta, _draw_mode,
+                      _intersection_point, _intersection_normal);
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
 
-    // for each triangle
-    for (const Triangle& triangle : triangles_)
+
+unsigned int Mesh::intersect_packet(const RayPacket& _packet,
+                                    unsigned int     _mask,
+                                    vec3             _intersection_point[],
+                                    vec3             _intersection_normal[],
+                                    Scalar           _intersection_t[]) const
+{
+    // the grid is walked ray by ray
+    if (acceleration_ == ACCEL_GRID)
+        return Object::intersect_packet(_packet, _mask, _intersection_point,
+                                        _intersection_normal, _intersection_t);
+
+    // the closest hit of each lane: triangle index and barycentric coordinates
+    unsigned int hit[RayPacket::SIZE];
+    Scalar       t, alpha, beta, hit_alpha[RayPacket::SIZE], hit_beta[RayPacket::SIZE];
+    unsigned int hits = 0;
+
+    RayPacket packet(_packet);
+    bvh_.traverse_packet(packet, _mask, [&](unsigned int n, RayPacket& p, unsigned int lanes)
     {
-        // does ray intersect triangle?
-        if (intersect_triangle(triangle, _ray, p, n, t))
+        const unsigned int first = leaf_blocks_[n];
+        const unsigned int last  = first + (bvh_.nodes()[n].count + BLOCK_SIZE-1) / BLOCK_SIZE;
+        for (unsigned int b=first; b<last; ++b)
         {
-            // is intersection closer than previous intersections?
-            if (t < _intersection_t)
+            for (int l=0; l<RayPacket::SIZE; ++l)
             {
-                // store data of this intersection
-                _intersection_t      = t;
-                _intersection_point  = p;
-                _intersection_normal = n;
+                if (!(lanes & (1u << l))) continue;
+                const int lane = hit_block(blocks_[b], p.ray[l], t, alpha, beta);
+                if (lane >= 0)
+                {
+                    p.ray[l].tmax = _intersection_t[l] = t;
+                    hit[l] = blocks_[b].index[lane];  hit_alpha[l] = alpha;  hit_beta[l] = beta;
+                    hits |= (1u << l);
+                }
             }
         }
+    });
+
+    // compute point and normal only once per lane, for the closest intersection
+    for (int l=0; l<RayPacket::SIZE; ++l)
+    {
+        if (hits & (1u << l))
+            intersection_data(hit[l], _packet.ray[l], _intersection_t[l], hit_alpha[l], hit_beta[l], draw_mode_,
+                              _intersection_point[l], _intersection_normal[l]);
     }
+    return hits;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Mesh::occluded(const Ray& _ray) const
+{
+    // any triangle hit within the ray's interval will do, so neither
+    // intersection point nor normal are computed
+    Scalar t, alpha, beta;
 
-    return (_intersection_t != NO_INTERSECTION);
+    if (acceleration_ == ACCEL_GRID)
+    {
+        return grid_.occluded(_ray, [&](unsigned int i)
+        {
+            return hit_triangle(i, _ray, t, alpha, beta);
+        });
+    }
+    else
+    {
+        return bvh_.occluded_leaves(_ray, [&](unsigned int n)
+        {
+            const unsigned int first = leaf_blocks_[n];
+            const unsigned int last  = first + (bvh_.nodes()[n].count + BLOCK_SIZE-1) / BLOCK_SIZE;
+            for (unsigned int b=first; b<last; ++b)
+                if (hit_block(blocks_[b], _ray, t, alpha, beta) >= 0) return true;
+            return false;
+        });
+    }
 }
 
 
@@ -382,67 +926,244 @@ bool Mesh::intersect(const Ray& _ray,
 
 bool
 Mesh::
-intersect_triangle(const Triangle&  _triangle,
-                   const Ray&       _ray,
-                   vec3&            _intersection_point,
-                   vec3&            _intersection_normal,
-                   double&          _intersection_t) const
+hit_triangle(unsigned int     _i,
+             const Ray&       _ray,
+             Scalar&          _t,
+             Scalar&          _alpha,
+             Scalar&          _beta) const
 {
-    //Get the vertices of the given triangle:
-    const vec3& p0 = vertices_[_triangle.i0].position;
-    const vec3& p1 = vertices_[_triangle.i1].position;
-    const vec3& p2 = vertices_[_triangle.i2].position;
-
     //A triangle can be represented through this formula: x = 1*U + a*A + b*B
-    // U is the origin of the triangle, A and B are the two vectors that indicate the other two Vertices starting from U
-    // 0 <= a,b <= 1
+    // U is the origin of the triangle (p2), A = p0 - p2 and B = p1 - p2 are the two
+    // precomputed edges that indicate the other two vertices starting from U
     //To find the intersection with a ray: o + td = 1*U + a*A + b*B
     //This is the same as: o - U = a*A + b*B - td
-    //Seen as a matrix: o - U = (A,B,d) * (a,b,t)^T
+    //Seen as a matrix: o - U = (A,B,-d) * (a,b,t)^T
+    //Cramer's rule with the determinants written as triple products gives
+    //the Moeller-Trumbore algorithm, which only needs two cross products.
+    const Triangle_record& r = records_[_i];
+
+    const vec3   pvec = cross(_ray.direction, r.edge1);
+    const Scalar detA = dot(r.edge0, pvec);
+    if (detA == 0.0) {
+        return false; // ray is parallel to the triangle
+    }
+    const Scalar invDetA = 1.0 / detA;
 
     // o - U
-    const vec3 b = _ray.origin - p2;
+    const vec3 tvec = _ray.origin - r.origin;
 
     // a
-    const vec3 alphaPart = p0 - p2;
-
-    // b
-    const vec3 betaPart = p1 - p2;
-
-    // -d
-    const vec3 tPart = _ray.direction * (-1);
-
-    //Matrix (A,B,d)
-    const std::vector<vec3> A = { alphaPart, betaPart, tPart};
+    const Scalar alpha = dot(tvec, pvec) * invDetA;
+    if (alpha < 0 || alpha > 1) {
+        return false;
+    }
 
-    //Cramer's Rule applied:
-    const double detA = determinant3x3(A);
-    // a
-    const double alpha = determinant3x3({b, betaPart, tPart}) / detA;
     // b
-    const double beta = determinant3x3({alphaPart, b, tPart}) / detA;
-    // t
-    const double t = determinant3x3({alphaPart, betaPart, b}) / detA;
+    const vec3   qvec = cross(tvec, r.edge0);
+    const Scalar beta = dot(_ray.direction, qvec) * invDetA;
 
     // a and b must be positive. Here gamma doesn't refer to the other formula seen in the lesson.
     // gamma is used to check whether a and b are smaller-equal 1 or not
-    const double gamma = 1 - alpha - beta;
-    if (t < 0 || alpha < 0 || beta < 0 || gamma < 0) {
+    if (beta < 0 || 1 - alpha - beta < 0) {
         return false;
     }
 
-    //Saves the things that we need:
-    _intersection_t = t;
-    _intersection_point = _ray(_intersection_t);
+    // t must lie within the ray's interval, i.e., in front of the viewer
+    // and in front of the closest intersection found so far
+    const Scalar t = dot(r.edge1, qvec) * invDetA;
+    if (!(t > _ray.tmin && t < _ray.tmax)) {
+        return false;
+    }
+
+    _t     = t;
+    _alpha = alpha;
+    _beta  = beta;
+    return true;
+}
+
+
+//-----------------------------------------------------------------------------
+
 
-    //Returns the right _intersection_normal according to the draw_mode_
-    if (draw_mode_ == FLAT) {
-        _intersection_normal = normalize(_triangle.normal);
+int
+Mesh::
+hit_block(const Triangle_block& _block,
+          const Ray&            _ray,
+          Scalar&               _t,
+          Scalar&               _alpha,
+          Scalar&               _beta)
+{
+    // the same computation as in hit_triangle(), for all lanes at once
+    Scalar t[BLOCK_SIZE], alpha[BLOCK_SIZE], beta[BLOCK_SIZE];
+    int    valid[BLOCK_SIZE];
+
+#if defined(__AVX2__)
+    static_assert(BLOCK_SIZE * sizeof(Scalar) == sizeof(simd), "AVX2 kernel expects blocks of one register");
+
+    const simd zero = simd_zero();
+    const simd one  = simd_set1(1.0);
+
+    const simd dx = simd_set1(_ray.direction[0]);
+    const simd dy = simd_set1(_ray.direction[1]);
+    const simd dz = simd_set1(_ray.direction[2]);
+
+    const simd e0x = simd_load(_block.edge0[0]);
+    const simd e0y = simd_load(_block.edge0[1]);
+    const simd e0z = simd_load(_block.edge0[2]);
+    const simd e1x = simd_load(_block.edge1[0]);
+    const simd e1y = simd_load(_block.edge1[1]);
+    const simd e1z = simd_load(_block.edge1[2]);
+
+    // pvec = d x edge1, det = edge0 . pvec
+    const simd px = simd_sub(simd_mul(dy, e1z), simd_mul(dz, e1y));
+    const simd py = simd_sub(simd_mul(dz, e1x), simd_mul(dx, e1z));
+    const simd pz = simd_sub(simd_mul(dx, e1y), simd_mul(dy, e1x));
+    const simd det = simd_add(simd_add(simd_mul(e0x, px), simd_mul(e0y, py)),
+                                      simd_mul(e0z, pz));
+    const simd inv_det = simd_div(one, det);
+
+    // tvec = o - origin
+    const simd tx = simd_sub(simd_set1(_ray.origin[0]), simd_load(_block.origin[0]));
+    const simd ty = simd_sub(simd_set1(_ray.origin[1]), simd_load(_block.origin[1]));
+    const simd tz = simd_sub(simd_set1(_ray.origin[2]), simd_load(_block.origin[2]));
+
+    const simd a = simd_mul(simd_add(simd_add(simd_mul(tx, px), simd_mul(ty, py)),
+                                                  simd_mul(tz, pz)), inv_det);
+
+    // qvec = tvec x edge0
+    const simd qx = simd_sub(simd_mul(ty, e0z), simd_mul(tz, e0y));
+    const simd qy = simd_sub(simd_mul(tz, e0x), simd_mul(tx, e0z));
+    const simd qz = simd_sub(simd_mul(tx, e0y), simd_mul(ty, e0x));
+
+    const simd b = simd_mul(simd_add(simd_add(simd_mul(dx, qx), simd_mul(dy, qy)),
+                                                  simd_mul(dz, qz)), inv_det);
+    const simd tt = simd_mul(simd_add(simd_add(simd_mul(e1x, qx), simd_mul(e1y, qy)),
+                                                   simd_mul(e1z, qz)), inv_det);
+
+    simd mask = simd_cmp<_CMP_NEQ_OQ>(det, zero);
+    mask = simd_and(mask, simd_cmp<_CMP_GE_OQ>(a, zero));
+    mask = simd_and(mask, simd_cmp<_CMP_LE_OQ>(a, one));
+    mask = simd_and(mask, simd_cmp<_CMP_GE_OQ>(b, zero));
+    mask = simd_and(mask, simd_cmp<_CMP_GE_OQ>(simd_sub(simd_sub(one, a), b), zero));
+    mask = simd_and(mask, simd_cmp<_CMP_GT_OQ>(tt, simd_set1(_ray.tmin)));
+    mask = simd_and(mask, simd_cmp<_CMP_LT_OQ>(tt, simd_set1(_ray.tmax)));
+
+    simd_store(t,     tt);
+    simd_store(alpha, a);
+    simd_store(beta,  b);
+    const int bits = simd_movemask(mask);
+    for (int lane=0; lane<BLOCK_SIZE; ++lane)
+        valid[lane] = (bits >> lane) & 1;
+#else
+    // portable version, written lane by lane without branches
+    for (int lane=0; lane<BLOCK_SIZE; ++lane)
+    {
+        const Scalar d[3]  = { _ray.direction[0], _ray.direction[1], _ray.direction[2] };
+        const Scalar e0[3] = { _block.edge0[0][lane], _block.edge0[1][lane], _block.edge0[2][lane] };
+        const Scalar e1[3] = { _block.edge1[0][lane], _block.edge1[1][lane], _block.edge1[2][lane] };
+
+        const Scalar p[3] = { d[1]*e1[2] - d[2]*e1[1],
+                              d[2]*e1[0] - d[0]*e1[2],
+                              d[0]*e1[1] - d[1]*e1[0] };
+        const Scalar det     = e0[0]*p[0] + e0[1]*p[1] + e0[2]*p[2];
+        const Scalar inv_det = 1.0 / det;
+
+        const Scalar tv[3] = { _ray.origin[0] - _block.origin[0][lane],
+                               _ray.origin[1] - _block.origin[1][lane],
+                               _ray.origin[2] - _block.origin[2][lane] };
+        const Scalar a = (tv[0]*p[0] + tv[1]*p[1] + tv[2]*p[2]) * inv_det;
+
+        const Scalar q[3] = { tv[1]*e0[2] - tv[2]*e0[1],
+                              tv[2]*e0[0] - tv[0]*e0[2],
+                              tv[0]*e0[1] - tv[1]*e0[0] };
+        const Scalar b  = (d[0]*q[0] + d[1]*q[1] + d[2]*q[2]) * inv_det;
+        const Scalar tt = (e1[0]*q[0] + e1[1]*q[1] + e1[2]*q[2]) * inv_det;
+
+        t[lane]     = tt;
+        alpha[lane] = a;
+        beta[lane]  = b;
+        valid[lane] = (det != 0.0) & (a >= 0.0) & (a <= 1.0) & (b >= 0.0) & (1.0 - a - b >= 0.0) &
+                      (tt > _ray.tmin) & (tt < _ray.tmax);
+    }
+#endif
+
+    // pick the closest valid lane
+    int closest = -1;
+    for (int lane=0; lane<BLOCK_SIZE; ++lane)
+    {
+        if (valid[lane] && (closest < 0 || t[lane] < t[closest]))
+            closest = lane;
+    }
+
+    if (closest >= 0)
+    {
+        _t     = t[closest];
+        _alpha = alpha[closest];
+        _beta  = beta[closest];
+    }
+    return closest;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void
+Mesh::
+intersection_data(unsigned int _i, const Ray& _ray,
+                  Scalar _t, Scalar _alpha, Scalar _beta,
+                  Draw_mode _draw_mode,
+                  vec3& _intersection_point,
+                  vec3& _intersection_normal) const
+{
+    const Scalar gamma = 1 - _alpha - _beta;
+
+    _intersection_point = _ray(_t);
+
+    //Returns the right _intersection_normal according to the draw mode
+    if (compact_) {
+        const uint32_t* t = &indices_[3*_i];
+        if (_draw_mode == FLAT) {
+            vec3 p0, p1, p2;
+            triangle_positions(_i, p0, p1, p2);
+            _intersection_normal = normalize(cross(p1-p0, p2-p0));
+        } else {
+            _intersection_normal = normalize(
+                _alpha * decode_normal(compact_vertices_[t[0]].normal) +
+                _beta  * decode_normal(compact_vertices_[t[1]].normal) +
+                gamma  * decode_normal(compact_vertices_[t[2]].normal));
+        }
     } else {
-        _intersection_normal = normalize(
-            alpha * vertices_[_triangle.i0].normal + beta * vertices_[_triangle.i1].normal + gamma * vertices_[_triangle
-                .i2].normal);
+        const Triangle& triangle = triangles_[_i];
+        if (_draw_mode == FLAT) {
+            _intersection_normal = triangle.normal;
+        } else {
+            _intersection_normal = normalize(
+                _alpha * vertices_[triangle.i0].normal + _beta * vertices_[triangle.i1].normal + gamma * vertices_[triangle.i2].normal);
+        }
     }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool
+Mesh::
+intersect_triangle(unsigned int     _i,
+                   const Ray&       _ray,
+                   vec3&            _intersection_point,
+                   vec3&            _intersection_normal,
+                   Scalar&          _intersection_t) const
+{
+    Scalar t, alpha, beta;
+    if (!hit_triangle(_i, _ray, t, alpha, beta)) {
+        return false;
+    }
+
+    //Saves the things that we need:
+    _intersection_t = t;
+    intersection_data(_i, _ray, t, alpha, beta, draw_mode_, _intersection_point, _intersection_normal);
 
     return true;
     /** \todo
@@ -15,6 +15,9 @@
 //== INCLUDES =================================================================
 
 #include "Object.h"
+#include "BVH.h"
+#include "Grid.h"
+#include <cstdint>
 #include <vector>
 #include <string>
 
@@ -33,9 +36,59 @@ public:
 
     /// Construct a mesh by parsing its path and properties from an input
     /// stream. The mesh path read from the file is relative to the 
-    /// scene file's path "scenePath".
+    /// scene file's path "scenePath". The mesh stays empty until load()
+    /// is called, which allows a scene to load its meshes in parallel.
     Mesh(std::istream &is, const std::string &scenePath);
 
+    /// Construct a mesh that is loaded from OFF file \c _filename by load(),
+    /// with Phong shading and the default material. Used for meshes that
+    /// are only placed in the scene by instances (see Instance).
+    explicit Mesh(const std::string& _filename);
+
+    /// Path of the mesh file \c _meshFile given in the scene file
+    /// \c _scenePath, to which it is relative.
+    static std::string resolve_path(const std::string& _meshFile, const std::string& _scenePath);
+
+    /// Parse a draw mode ("FLAT" or "PHONG"), throw std::runtime_error for
+    /// other strings.
+    static Draw_mode parse_draw_mode(const std::string& _mode);
+
+    /// Read the mesh from the file given to the constructor, see read(),
+    /// and build the acceleration structure \c _accel over its triangles
+    /// (the one the scene uses), such that no other one is built in vain.
+    void load(Acceleration _accel = ACCEL_BVH)
+    {
+        acceleration_ = _accel;
+        read(filename_);
+    }
+
+    /// path of the OFF file given to the constructor
+    const std::string& filename() const { return filename_; }
+
+    /// number of vertices
+    size_t num_vertices() const { return compact_ ? compact_vertices_.size() : vertices_.size(); }
+
+    /// number of triangles
+    size_t num_triangles() const { return compact_ ? indices_.size() / 3 : triangles_.size(); }
+
+    /// Switch to the compact representation: float vertex positions with
+    /// octahedral normals packed into 32 bits, a plain index buffer, and no
+    /// triangle normals, which are recomputed for flat shading when needed.
+    /// Also releases the intersection records the BVH was built from. The
+    /// mesh stays compact until the next read(). Intersections are computed
+    /// as before, only shading normals lose some precision.
+    void compact();
+
+    /// Is the mesh stored in the compact representation (see compact())?
+    bool is_compact() const { return compact_; }
+
+    /// Number of bytes allocated for the mesh's geometry and acceleration
+    /// structures.
+    size_t memory() const;
+
+    /// was the mesh loaded from its cache file by the last read()?
+    bool cached() const { return cached_; }
+
     /// Intersect mesh with ray (calls ray-triangle intersection)
     /// If \c _ray intersects a face of the mesh, it provides the following results:
     /// \param[in] _ray the ray to intersect the mesh with
@@ -45,7 +98,33 @@ public:
     virtual bool intersect(const Ray& _ray,
                            vec3&      _intersection_point,
                            vec3&      _intersection_normal,
-                           double&    _intersection_t) const override;
+                           Scalar&    _intersection_t) const override;
+
+    /// Like intersect(), but compute the normal according to \c _draw_mode
+    /// instead of the mesh's own draw mode. This lets instances of the mesh
+    /// choose between flat and Phong shading.
+    bool intersect(const Ray& _ray,
+                   Draw_mode  _draw_mode,
+                   vec3&      _intersection_point,
+                   vec3&      _intersection_normal,
+                   Scalar&    _intersection_t) const;
+
+    /// Intersect the mesh with the rays of \c _packet selected by \c _mask,
+    /// traversing the BVH once for the whole packet.
+    /// This function overrides Object::intersect_packet().
+    virtual unsigned int intersect_packet(const RayPacket& _packet,
+                                          unsigned int     _mask,
+                                          vec3             _intersection_point[],
+                                          vec3             _intersection_normal[],
+                                          Scalar           _intersection_t[]) const override;
+
+    /// Does \c _ray hit any triangle of the mesh within its interval?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray) const override;
+
+    /// Return the bounding box of the mesh.
+    /// This function overrides Object::bounds().
+    virtual bool bounds(vec3& _bb_min, vec3& _bb_max) const override;
 
 private:
     /// a vertex consists of a position and a normal
@@ -70,9 +149,50 @@ private:
         vec3 normal;
     };
 
+    /// a vertex of the compact representation (see compact())
+    struct Compact_vertex
+    {
+        /// vertex position
+        float position[3];
+        /// vertex normal, see encode_normal()
+        uint32_t normal;
+    };
+
+    /// precomputed data for intersecting a ray with a triangle, such that
+    /// intersection tests neither look up vertices nor compute edges
+    struct Triangle_record
+    {
+        /// position of the third vertex (i2)
+        vec3 origin;
+        /// edge from the third to the first vertex
+        vec3 edge0;
+        /// edge from the third to the second vertex
+        vec3 edge1;
+    };
+
+    /// number of triangles intersected at once by the SIMD kernel, such that
+    /// a block component fills a 256-bit register (4 doubles or 8 floats)
+    static constexpr int BLOCK_SIZE = 32 / sizeof(Scalar);
+
+    /// the intersection records of up to BLOCK_SIZE triangles of a BVH leaf,
+    /// stored component-wise (structure of arrays) for SIMD processing.
+    /// Unused lanes have zero edges and therefore never report a hit.
+    struct alignas(32) Triangle_block
+    {
+        /// coordinates of Triangle_record::origin (x, y, z) for each lane
+        Scalar origin[3][BLOCK_SIZE];
+        /// coordinates of Triangle_record::edge0 (x, y, z) for each lane
+        Scalar edge0[3][BLOCK_SIZE];
+        /// coordinates of Triangle_record::edge1 (x, y, z) for each lane
+        Scalar edge1[3][BLOCK_SIZE];
+        /// triangle index (for array Mesh::triangles_) for each lane
+        unsigned int index[BLOCK_SIZE];
+    };
+
 public:
-    /// Read mesh from an OFF file
-    bool read(const std::string &_filename);
+    /// Read mesh from an OFF file (or its cache, see cache_path()). Throws
+    /// std::runtime_error if the file cannot be read or is invalid.
+    void read(const std::string &_filename);
 
     /// Compute normal vectors for triangles and vertices
     void compute_normals();
@@ -80,24 +200,125 @@ public:
     /// Compute the axis-aligned bounding box, store minimum and maximum point in bb_min_ and bb_max_
     void compute_bounding_box();
 
+    /// Precompute the intersection records of all triangles (after the vertices changed)
+    void compute_triangle_records();
+
+    /// Build the bounding volume hierarchy over the mesh's triangles and
+    /// pack the triangles of its leaves into SIMD blocks
+    void build_bvh();
+
+    /// Build the uniform grid over the mesh's triangles
+    void build_grid();
+
+    /// Choose between BVH and uniform grid for the triangles, builds the
+    /// chosen structure and releases the other one.
+    /// This function overrides Object::set_acceleration().
+    virtual void set_acceleration(Acceleration _accel) override;
+
     /// Does \c _ray intersect the bounding box of the mesh?
     bool intersect_bounding_box(const Ray& _ray) const;
 
+    /// Intersect a triangle with a ray within its interval, but only compute
+    /// the ray parameter and barycentric coordinates of the intersection.
+    /// Uses the precomputed Triangle_record and does not allocate memory.
+    /// \param[in] _i index of the triangle to be intersected (for array Mesh::triangles_)
+    /// \param[in] _ray the ray to intersect the triangle with
+    /// \param[out] _t ray parameter at the intersection point
+    /// \param[out] _alpha barycentric coordinate of the first vertex
+    /// \param[out] _beta barycentric coordinate of the second vertex
+    bool hit_triangle(unsigned int     _i,
+                      const Ray&       _ray,
+                      Scalar&          _t,
+                      Scalar&          _alpha,
+                      Scalar&          _beta) const;
+
+    /// Intersect all triangles of a block with a ray at once (using SIMD
+    /// instructions if available), return the lane of the closest
+    /// intersection within the ray's interval or -1 if there is none.
+    /// This is the vectorized version of hit_triangle().
+    /// \param[in] _block the block of triangles to be intersected
+    /// \param[in] _ray the ray to intersect the triangles with
+    /// \param[out] _t ray parameter at the closest intersection point
+    /// \param[out] _alpha barycentric coordinate of the first vertex
+    /// \param[out] _beta barycentric coordinate of the second vertex
+    static int hit_block(const Triangle_block& _block,
+                         const Ray&            _ray,
+                         Scalar&               _t,
+                         Scalar&               _alpha,
+                         Scalar&               _beta);
+
     /// Intersect a triangle with a ray. Return whether there is an intersection.
     /// If there is an intersection, store intersection data.
     /// This function overrides Object::intersect().
-    /// \param[in] _triangle the triangle to be intersected
+    /// \param[in] _i index of the triangle to be intersected (for array Mesh::triangles_)
     /// \param[in] _ray the ray to intersect the triangle with
     /// \param[out] _intersection_point the point of intersection
     /// \param[out] _intersection_normal the surface normal at intersection point
     /// \param[out] _intersection_t ray parameter at the intersection point
-    bool intersect_triangle(const Triangle&  _triangle,
+    bool intersect_triangle(unsigned int     _i,
                             const Ray&       _ray,
                             vec3&            _intersection_point,
                             vec3&            _intersection_normal,
-                            double&          _intersection_t) const;
+                            Scalar&          _intersection_t) const;
+
+    /// Path of the cache file of OFF file \c _filename: next to it, or in
+    /// the directory given by the environment variable RAYTRACE_MESH_CACHE.
+    /// Empty if RAYTRACE_MESH_CACHE is "off", which disables the cache.
+    static std::string cache_path(const std::string& _filename);
+
+private:
+    /// identifies the contents of an OFF file, such that a cache built from
+    /// it is only used as long as the file is unchanged
+    struct Cache_key
+    {
+        /// file size in bytes
+        uint64_t size;
+        /// modification time (seconds since the epoch)
+        int64_t  mtime;
+        /// hash of the file contents
+        uint64_t hash;
+    };
+
+    /// Load vertices, triangles, bounding box, intersection records, and
+    /// BVH from the cache file \c _cache. Returns false (and changes
+    /// nothing) if the file does not exist, was built from another version
+    /// of the OFF file than \c _key describes, or by an incompatible build.
+    bool read_cache(const std::string& _cache, const Cache_key& _key);
+
+    /// Store the data loaded by read_cache() in the cache file \c _cache.
+    /// Failures (e.g., a read-only directory) are silently ignored.
+    void write_cache(const std::string& _cache, const Cache_key& _key) const;
+
+    /// positions of the vertices of triangle \c _i (in either representation)
+    void triangle_positions(unsigned int _i, vec3& _p0, vec3& _p1, vec3& _p2) const;
+
+    /// Encode the unit vector \c _n by mapping the unit sphere onto an
+    /// octahedron, which is unfolded into a square, and storing the two
+    /// coordinates in that square with 16 bits each
+    static uint32_t encode_normal(const vec3& _n);
+
+    /// Decode a unit vector encoded by encode_normal()
+    static vec3 decode_normal(uint32_t _n);
+
+    /// Compute the bounding boxes of all triangles
+    void triangle_bounds(std::vector<vec3>& _bb_min, std::vector<vec3>& _bb_max) const;
+
+    /// Compute the intersection point and normal for a hit of triangle \c _i
+    /// at ray parameter \c _t and barycentric coordinates \c _alpha, \c _beta
+    /// with flat or Phong shading as chosen by \c _draw_mode
+    void intersection_data(unsigned int _i, const Ray& _ray,
+                           Scalar _t, Scalar _alpha, Scalar _beta,
+                           Draw_mode _draw_mode,
+                           vec3& _intersection_point,
+                           vec3& _intersection_normal) const;
 
 private:
+    /// path of the OFF file
+    std::string filename_;
+
+    /// was the mesh loaded from its cache file?
+    bool cached_ = false;
+
     /// Does this mesh use flat or Phong shading?
     Draw_mode draw_mode_;
 
@@ -107,10 +328,38 @@ private:
     /// Array of triangles
     std::vector<Triangle> triangles_;
 
+    /// Is the mesh stored in the compact representation?
+    bool compact_ = false;
+
+    /// Array of vertices in the compact representation (replaces vertices_)
+    std::vector<Compact_vertex> compact_vertices_;
+
+    /// vertex indices, three per triangle, in the compact representation
+    /// (replaces triangles_)
+    std::vector<uint32_t> indices_;
+
+    /// Array of precomputed intersection records (one per triangle)
+    std::vector<Triangle_record> records_;
+
     /// Minimum point of the bounding box
     vec3 bb_min_;
     /// Maximum point of the bounding box
     vec3 bb_max_;
+
+    /// Which acceleration structure indexes the triangles?
+    Acceleration acceleration_ = ACCEL_BVH;
+
+    /// Bounding volume hierarchy over the triangles
+    BVH bvh_;
+
+    /// Triangles of the BVH leaves, packed into SIMD blocks
+    std::vector<Triangle_block> blocks_;
+
+    /// index of the first block of each BVH leaf (indexed by node)
+    std::vector<unsigned int> leaf_blocks_;
+
+    /// Uniform grid over the triangles
+    Grid grid_;
 };
 
 
@@ -14,6 +14,7 @@
 //== INCLUDES =================================================================
 
 #include "Ray.h"
+#include "RayPacket.h"
 #include "vec3.h"
 #include "Material.h"
 
@@ -24,6 +25,11 @@
 //== CLASS DEFINITION =========================================================
 
 
+/// This type is used to choose the acceleration structure that indexes
+/// the objects of a scene or the primitives of an object
+enum Acceleration {ACCEL_BVH, ACCEL_GRID};
+
+
 /// \class Object Object.h
 /// This class implements an abstract class for an object.
 /// Every derived object type will inherit the material property, and it
@@ -39,6 +45,8 @@ public:
     virtual ~Object() {}
 
     /// Intersect the object with \c _ray, return whether there is an intersection.
+    /// Only intersections within the ray's interval (`_ray.tmin`, `_ray.tmax`)
+    /// count, which lets objects bail out early behind a closer intersection.
     /// If \c _ray intersects the object, provide the following results:
     /// \param[in] _ray the ray to intersect the object with
     /// \param[out] _intersection_point the point of intersection
@@ -47,7 +55,52 @@ public:
     virtual bool intersect(const Ray&  _ray,
                            vec3&       _intersection_point,
                            vec3&       _intersection_normal,
-                           double&     _intersection_t) const = 0;
+                           Scalar&     _intersection_t) const = 0;
+
+    /// Intersect the object with the rays of \c _packet selected by \c _mask.
+    /// Works like intersect() for each of these rays and returns the mask of
+    /// lanes that intersect the object. The results of lane i are stored in
+    /// entry i of the output arrays, which hold RayPacket::SIZE entries.
+    /// The default implementation intersects the rays one by one; objects
+    /// with an acceleration structure override it to traverse it once for
+    /// the whole packet.
+    virtual unsigned int intersect_packet(const RayPacket& _packet,
+                                          unsigned int     _mask,
+                                          vec3             _intersection_point[],
+                                          vec3             _intersection_normal[],
+                                          Scalar           _intersection_t[]) const
+    {
+        unsigned int hits = 0;
+        for (int i=0; i<RayPacket::SIZE; ++i)
+        {
+            if ((_mask & (1u << i)) &&
+                intersect(_packet.ray[i], _intersection_point[i], _intersection_normal[i], _intersection_t[i]))
+                hits |= (1u << i);
+        }
+        return hits;
+    }
+
+    /// Does \c _ray hit the object within its interval (`_ray.tmin`, `_ray.tmax`)?
+    /// Unlike intersect(), this only answers whether there is any intersection,
+    /// which is all shadow rays need. The default implementation calls
+    /// intersect(); derived objects override it to skip computing the
+    /// intersection point and normal.
+    virtual bool occluded(const Ray& _ray) const
+    {
+        vec3   p, n;
+        Scalar t;
+        return intersect(_ray, p, n, t);
+    }
+
+    /// Compute the axis-aligned bounding box of the object. Return whether the
+    /// object is bounded; unbounded objects (e.g. planes) return false.
+    /// \param[out] _bb_min minimum point of the bounding box
+    /// \param[out] _bb_max maximum point of the bounding box
+    virtual bool bounds(vec3& /*_bb_min*/, vec3& /*_bb_max*/) const { return false; }
+
+    /// Choose the acceleration structure for the object's own primitives.
+    /// Objects without primitives (e.g. spheres) ignore this.
+    virtual void set_acceleration(Acceleration /*_accel*/) {}
 
     /// parse object properties from an input stream
     virtual void parse(std::istream &is) { throw std::logic_error("Unimplemented"); }
@@ -55,7 +108,7 @@ public:
     /// The material of this object
     Material material;
 
-    static constexpr double NO_INTERSECTION = std::numeric_limits<double>::max();
+    static constexpr Scalar NO_INTERSECTION = std::numeric_limits<Scalar>::max();
 };
 
 /// read object from stream
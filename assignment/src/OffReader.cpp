@@ -0,0 +1,250 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "OffReader.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+/// chunks are at least this large, such that small files are parsed by a
+/// single thread
+constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+/// a syntax error at a line of the file
+struct Parse_error
+{
+    size_t      line;
+    std::string message;
+};
+
+/// skip spaces and tabs (but not line breaks)
+inline const char* skip_blanks(const char* _p, const char* _end)
+{
+    while (_p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\r')) ++_p;
+    return _p;
+}
+
+/// parse a number of type T at \c _p (after blanks), advance \c _p behind it
+template <class T>
+inline bool parse_number(const char*& _p, const char* _end, T& _value)
+{
+    _p = skip_blanks(_p, _end);
+    if (_p < _end && *_p == '+') ++_p; // not accepted by from_chars
+    const std::from_chars_result r = std::from_chars(_p, _end, _value);
+    if (r.ec != std::errc()) return false;
+    _p = r.ptr;
+    return true;
+}
+
+/// does the line [_p, _end) hold data, i.e., is it neither empty nor a comment?
+inline bool is_data(const char* _p, const char* _end)
+{
+    _p = skip_blanks(_p, _end);
+    return _p < _end && *_p != '#';
+}
+
+/// end of the line starting at \c _p (the position of its '\n' or \c _end)
+inline const char* line_end(const char* _p, const char* _end)
+{
+    const void* nl = std::memchr(_p, '\n', _end - _p);
+    return nl ? static_cast<const char*>(nl) : _end;
+}
+
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void OffReader::parse(const std::string&         _filename,
+                      const char*                _data,
+                      size_t                     _size,
+                      std::vector<vec3>&         _positions,
+                      std::vector<unsigned int>& _triangles)
+{
+    const char* const end = _data + _size;
+
+    auto fail = [&](size_t _line, const std::string& _message)
+    {
+        throw std::runtime_error(_filename + ":" + std::to_string(_line) + ": " + _message);
+    };
+
+
+    // header: the keyword and the numbers of vertices, faces, and edges,
+    // which may be on the same line or on the next data lines
+    const char* p    = _data;
+    size_t      line = 1;
+    auto next_token = [&]()
+    {
+        for (;;)
+        {
+            p = skip_blanks(p, end);
+            if (p == end) return false;
+            if (*p == '\n')      { ++p; ++line; }
+            else if (*p == '#')  { p = line_end(p, end); }
+            else return true;
+        }
+    };
+
+    if (!next_token())
+        fail(line, "empty file");
+    const char* keyword = p;
+    while (p < end && !std::isspace(static_cast<unsigned char>(*p))) ++p;
+    const std::string key(keyword, p);
+    if (key != "OFF" && key != "COFF" && key != "NOFF" && key != "CNOFF")
+        fail(line, "expected OFF header, found '" + key + "'");
+
+    unsigned long counts[3];
+    for (unsigned long& c: counts)
+        if (!next_token() || !parse_number(p, end, c))
+            fail(line, "expected numbers of vertices, faces, and edges");
+    const size_t num_vertices = counts[0];
+    const size_t num_faces    = counts[1];
+    if (num_vertices > std::numeric_limits<unsigned int>::max() ||
+        num_faces    > std::numeric_limits<unsigned int>::max())
+        fail(line, "too many vertices or faces");
+
+    // the body starts at the next line
+    p = line_end(p, end);
+    if (p < end) { ++p; ++line; }
+    const char*  body      = p;
+    const size_t body_line = line;
+
+
+    // split the body into chunks of whole lines
+    const int num_threads = parallel_threads();
+    const size_t body_size  = end - body;
+    const size_t num_chunks = std::max<size_t>(1, std::min<size_t>(4 * num_threads, body_size / MIN_CHUNK_SIZE));
+    std::vector<const char*> chunks(num_chunks + 1);
+    chunks[0]          = body;
+    chunks[num_chunks] = end;
+    for (size_t c=1; c<num_chunks; ++c)
+    {
+        const char* q = std::max(chunks[c-1], body + body_size * c / num_chunks);
+        q = line_end(q, end);
+        chunks[c] = (q < end) ? q+1 : end;
+    }
+
+    // first pass: count lines and data lines of each chunk, such that the
+    // second pass knows where each chunk starts
+    std::vector<size_t> lines(num_chunks + 1, 0), data_lines(num_chunks + 1, 0);
+    parallel_for(int(num_chunks), 1, [&](int c)
+    {
+        size_t n = 0, d = 0;
+        for (const char* q = chunks[c]; q < chunks[c+1]; )
+        {
+            const char* e = line_end(q, chunks[c+1]);
+            if (is_data(q, e)) ++d;
+            if (e < chunks[c+1]) ++n;
+            q = e + 1;
+        }
+        lines[c+1]      = n;
+        data_lines[c+1] = d;
+    });
+    for (size_t c=0; c<num_chunks; ++c)
+    {
+        lines[c+1]      += lines[c];
+        data_lines[c+1] += data_lines[c];
+    }
+    lines[0] = 0;
+    if (data_lines[num_chunks] < num_vertices + num_faces)
+        fail(body_line + lines[num_chunks] - (_size && end[-1] == '\n'), "expected " + std::to_string(num_vertices) + " vertices and " +
+             std::to_string(num_faces) + " faces, but the file ends after " +
+             std::to_string(data_lines[num_chunks]) + " lines of them");
+
+
+    // second pass: parse the vertices into their final position and the
+    // triangles of each chunk into a separate array, which are concatenated
+    // in order afterwards (faces may be split into several triangles)
+    _positions.resize(num_vertices);
+    std::vector<std::vector<unsigned int>> chunk_triangles(num_chunks);
+    std::vector<Parse_error>               errors(num_chunks);
+    parallel_for(int(num_chunks), 1, [&](int c)
+    {
+        size_t d = data_lines[c];
+        size_t l = body_line + lines[c];
+        std::vector<unsigned int>& triangles = chunk_triangles[c];
+        for (const char* q = chunks[c]; q < chunks[c+1] && d < num_vertices + num_faces; ++l)
+        {
+            const char* e = line_end(q, chunks[c+1]);
+            if (is_data(q, e))
+            {
+                if (d < num_vertices)
+                {
+                    Scalar x, y, z;
+                    if (!parse_number(q, e, x) || !parse_number(q, e, y) || !parse_number(q, e, z))
+                    {
+                        errors[c] = Parse_error{ l, "expected x, y, and z coordinate of vertex " + std::to_string(d) };
+                        break;
+                    }
+                    _positions[d] = vec3(x, y, z);
+                }
+                else
+                {
+                    const size_t f = d - num_vertices;
+                    unsigned int n, first = 0, previous = 0, i;
+                    if (!parse_number(q, e, n) || n < 3)
+                    {
+                        errors[c] = Parse_error{ l, "expected number of vertices (at least 3) of face " + std::to_string(f) };
+                        break;
+                    }
+                    for (unsigned int k=0; k<n; ++k)
+                    {
+                        if (!parse_number(q, e, i) || i >= num_vertices)
+                        {
+                            errors[c] = Parse_error{ l, "expected " + std::to_string(n) + " vertex indices below " +
+                                                        std::to_string(num_vertices) + " for face " + std::to_string(f) };
+                            break;
+                        }
+                        if (k == 0) first = i;
+                        if (k >= 2)
+                        {
+                            triangles.push_back(first);
+                            triangles.push_back(previous);
+                            triangles.push_back(i);
+                        }
+                        previous = i;
+                    }
+                    if (!errors[c].message.empty()) break;
+                }
+                ++d;
+            }
+            q = e + 1;
+        }
+    });
+
+    // report the first error in the file
+    for (const Parse_error& error: errors)
+        if (!error.message.empty())
+            fail(error.line, error.message);
+
+    size_t num_triangles = 0;
+    for (const auto& t: chunk_triangles) num_triangles += t.size();
+    _triangles.clear();
+    _triangles.reserve(num_triangles);
+    for (const auto& t: chunk_triangles)
+        _triangles.insert(_triangles.end(), t.begin(), t.end());
+}
+
+
+//=============================================================================
@@ -0,0 +1,58 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef OFFREADER_H
+#define OFFREADER_H
+
+
+//== INCLUDES =================================================================
+
+#include "vec3.h"
+#include <string>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class OffReader OffReader.h
+/// This class parses triangle meshes in OFF format from memory, e.g. from a
+/// MappedFile. Numbers are converted with std::from_chars, which neither
+/// depends on the locale nor goes through stream buffers, and the vertex
+/// and face lines are split into chunks that are parsed in parallel.
+///
+/// The file starts with the keyword OFF (or COFF, NOFF, CNOFF) and the
+/// numbers of vertices, faces, and edges. Then follows one line per vertex,
+/// starting with its x, y, and z coordinate, and one line per face,
+/// starting with its number of vertices n >= 3 and n vertex indices.
+/// Further values on these lines (e.g. colors) are ignored, as are empty
+/// lines and lines starting with '#'. Faces with more than three vertices
+/// are split into triangle fans.
+class OffReader
+{
+public:
+
+    /// Parse the \c _size bytes at \c _data, which are the contents of the
+    /// OFF file \c _filename, into vertex positions and the vertex indices of
+    /// the triangles (three per triangle). Throws std::runtime_error with
+    /// file name and line number if the file is invalid, e.g. if the header
+    /// is missing, a vertex lacks a coordinate, or a face refers to a vertex
+    /// that does not exist.
+    static void parse(const std::string&         _filename,
+                      const char*                _data,
+                      size_t                     _size,
+                      std::vector<vec3>&         _positions,
+                      std::vector<unsigned int>& _triangles);
+};
+
+
+//=============================================================================
+#endif // OFFREADER_H defined
+//=============================================================================
@@ -0,0 +1,78 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+
+//== INCLUDES =================================================================
+
+#if HAVE_OPENMP
+#  include <omp.h>
+#endif
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+/// Number of threads parallel_for() distributes its iterations to: the
+/// threads of the enclosing parallel region, if any, or the threads of a
+/// new one.
+inline int parallel_threads()
+{
+#if HAVE_OPENMP
+    return omp_in_parallel() ? omp_get_num_threads() : omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
+
+
+/// Call `_f(i)` for all i in [0, _n) in parallel, in chunks of `_chunk`
+/// consecutive iterations. Outside of a parallel region, the iterations
+/// are distributed among the threads of a new one. Inside (e.g. in a job
+/// of `raytrace --batch` or in a task of an outer parallel_for()), they
+/// become tasks, which any idle thread of the enclosing region executes,
+/// such that concurrent jobs share one pool of threads. Returns once all
+/// iterations are done.
+template <class Function>
+void parallel_for(int _n, int _chunk, Function&& _f)
+{
+    // the tasks copy a pointer to the function instead of the function
+    auto* f = &_f;
+    if (_n == 1)
+    {
+        (*f)(0);
+        return;
+    }
+
+#if HAVE_OPENMP
+    if (omp_in_parallel())
+    {
+#  pragma omp taskloop grainsize(_chunk)
+        for (int i=0; i<_n; ++i)
+            (*f)(i);
+        return;
+    }
+
+#  pragma omp parallel for schedule(dynamic, _chunk)
+    for (int i=0; i<_n; ++i)
+        (*f)(i);
+#else
+    (void)_chunk;
+    for (int i=0; i<_n; ++i)
+        (*f)(i);
+#endif
+}
+
+
+//=============================================================================
+#endif // PARALLEL_H defined
+//=============================================================================
@@ -33,15 +33,15 @@ Plane::
 intersect(const Ray& _ray,
           vec3&      _intersection_point,
           vec3&      _intersection_normal,
-          double&    _intersection_t ) const
+          Scalar&    _intersection_t ) const
 {
 
-    const double dn = dot(_ray.direction, normal);
+    const Scalar dn = dot(_ray.direction, normal);
 
-    if (fabs(dn) > std::numeric_limits<double>::min())
+    if (fabs(dn) > std::numeric_limits<Scalar>::min())
     {
-        const double t = dot(normal, center-_ray.origin) / dn;
-        if (t > 0)
+        const Scalar t = dot(normal, center-_ray.origin) / dn;
+        if (t > _ray.tmin && t < _ray.tmax)
         {
             _intersection_t      = t;
             _intersection_point  = _ray(t);
@@ -54,4 +54,23 @@ intersect(const Ray& _ray,
 }
 
 
+//-----------------------------------------------------------------------------
+
+
+bool
+Plane::
+occluded(const Ray& _ray) const
+{
+    const Scalar dn = dot(_ray.direction, normal);
+
+    if (fabs(dn) > std::numeric_limits<Scalar>::min())
+    {
+        const Scalar t = dot(normal, center-_ray.origin) / dn;
+        return (t > _ray.tmin && t < _ray.tmax);
+    }
+
+    return false;
+}
+
+
 //=============================================================================
@@ -43,7 +43,11 @@ public:
     virtual bool intersect(const Ray&  _ray,
                            vec3&       _intersection_point,
                            vec3&       _intersection_normal,
-                           double&     _intersection_t) const override;
+                           Scalar&     _intersection_t) const override;
+
+    /// Does \c _ray hit the plane within its interval?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray) const override;
 
     /// parse plane from an input stream
     virtual void parse(std::istream &is) override {
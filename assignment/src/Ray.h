@@ -15,6 +15,7 @@
 //== INCLUDES =================================================================
 
 #include "vec3.h"
+#include <limits>
 
 
 //== CLASS DEFINITION =========================================================
@@ -23,22 +24,38 @@
 /// \class Ray Ray.h
 /// This class implements a ray, specified by its origin and direction.
 /// It provides a convenient function to compute the point ray(t) at a specific
-/// ray paramter t.
+/// ray paramter t. Only the interval (tmin, tmax) of the ray is considered
+/// for intersections, which allows intersection routines to skip everything
+/// behind the closest intersection found so far. The reciprocal direction and
+/// its signs are precomputed for slab tests against axis-aligned boxes.
 class Ray
 {
 public:
 
     /// Constructor with origin and direction. Direction will be normalized.
+    /// \param[in] _origin origin of the ray
+    /// \param[in] _direction direction of the ray
+    /// \param[in] _tmin only intersections with t > _tmin are considered
+    /// \param[in] _tmax only intersections with t < _tmax are considered
     Ray(const vec3& _origin    = vec3(0,0,0),
-        const vec3& _direction = vec3(0,0,1))
+        const vec3& _direction = vec3(0,0,1),
+        Scalar      _tmin      = 0.0,
+        Scalar      _tmax      = std::numeric_limits<Scalar>::max())
+    : tmin(_tmin), tmax(_tmax)
     {
         origin    = _origin;
         direction = normalize(_direction); // normalize direction
+
+        for (int i=0; i<3; ++i)
+        {
+            inv_direction[i] = 1.0 / direction[i];
+            sign[i] = (inv_direction[i] < 0.0);
+        }
     }
 
     /// Compute the point on the ray at the parameter \c _t, which is
     /// origin + _t*direction.
-    vec3 operator()(double _t) const
+    vec3 operator()(Scalar _t) const
     {
         return origin + _t*direction;
     }
@@ -50,6 +67,16 @@ public:
     vec3 origin;
     /// direction of the ray (should be normalized)
     vec3 direction;
+
+    /// component-wise reciprocal of the direction
+    vec3 inv_direction;
+    /// sign[i] is 1 if direction[i] is negative, 0 otherwise
+    int sign[3];
+
+    /// start of the ray's parameter interval
+    Scalar tmin;
+    /// end of the ray's parameter interval, shrinks as closer intersections are found
+    Scalar tmax;
 };
 
 
@@ -59,7 +86,9 @@ public:
 /// read ray from stream
 inline std::istream& operator>>(std::istream& is, Ray& r)
 {
-    is >> r.origin >> r.direction;
+    vec3 origin, direction;
+    is >> origin >> direction;
+    r = Ray(origin, direction);
     return is;
 }
 
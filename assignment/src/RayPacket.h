@@ -0,0 +1,66 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef RAYPACKET_H
+#define RAYPACKET_H
+
+
+//== INCLUDES =================================================================
+
+#include "Ray.h"
+#include "vec3xN.h"
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class RayPacket RayPacket.h
+/// This class bundles a few coherent rays, e.g. the primary rays of a 2x2
+/// block of pixels, that traverse the acceleration structures together.
+/// Every ray occupies one lane of the packet; lanes that are not in use
+/// (e.g. outside the image) or that already missed are masked off by
+/// clearing their bit in a lane mask. Origins and directions are also kept
+/// component-wise, such that objects can intersect all lanes at once.
+struct RayPacket
+{
+    /// number of lanes, i.e., rays in the packet
+    static constexpr int SIZE = 4;
+
+    /// lane mask with all lanes active
+    static constexpr unsigned int ALL = (1u << SIZE) - 1;
+
+    /// set lane \c _i to \c _ray and mark it active
+    void set(int _i, const Ray& _ray)
+    {
+        ray[_i] = _ray;
+        origins.set(_i, _ray.origin);
+        directions.set(_i, _ray.direction);
+        active |= (1u << _i);
+    }
+
+    /// the rays of all lanes
+    Ray ray[SIZE];
+
+    /// the origins of all lanes as a batch (component-wise copy of the rays').
+    /// Lanes without a ray are zero, since objects compute all lanes at once.
+    vec3xN<SIZE> origins = vec3xN<SIZE>(vec3(0));
+
+    /// the directions of all lanes as a batch (component-wise copy of the rays'),
+    /// zero for lanes without a ray
+    vec3xN<SIZE> directions = vec3xN<SIZE>(vec3(0));
+
+    /// bit i is set if lane i holds a ray
+    unsigned int active = 0;
+};
+
+
+//=============================================================================
+#endif // RAYPACKET_H defined
+//=============================================================================
@@ -15,55 +15,560 @@
 #include "Sphere.h"
 #include "Cylinder.h"
 #include "Mesh.h"
+#include "Instance.h"
+#include "TileScheduler.h"
+#include "Parallel.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <fstream>
 #include <limits>
 #include <map>
+#include <sstream>
 #include <functional>
 #include <stdexcept>
 
+//-----------------------------------------------------------------------------
+
+
+Image Scene::render()
+{
+    // allocate new image (for the rows of the shard, see setShard())
+    Image img(regionWidth(), getShard().rows());
+    render(img);
+
+    // Note: compiler will elide copy.
+    return img;
+}
+
+//-----------------------------------------------------------------------------
+
+void Scene::render(Image& _img)
+{
+    // the image holds the rows of the shard, which is the whole image
+    // (or region) unless rendering is split among several processes
+    const Shard shard = getShard();
+    if (_img.width() != shard.width() || _img.height() != shard.rows())
+        throw std::runtime_error("Image size does not match the camera's resolution");
+    if (size_t(region_x) + regionWidth() > camera.width || size_t(region_y) + regionHeight() > camera.height)
+        throw std::runtime_error("Region exceeds the camera's image");
+
+    // antialias() needs the objects seen through all pixels and reads the
+    // pixels back, which would defeat an image that is kept in a file
+    if (aa_samples > 1 && _img.is_mapped())
+        throw std::runtime_error("Antialiasing cannot render into a mapped image (out-of-core)");
+
+    const unsigned int num_threads = parallel_threads();
+
+    // tiles are dealt to the threads in Morton order and stolen when a
+    // thread runs out of work. The shard's bands are as high as the tiles.
+    const unsigned int tile = tileSize();
+    TileScheduler scheduler(_img.width(), _img.height(), tile, num_threads);
+
+    // the object seen through each pixel, needed to find the pixels to antialias
+    std::vector<Object_ptr> objects(aa_samples > 1 ? size_t(_img.width()) * _img.height() : 0);
+
+    // Function rendering all tiles a thread gets from the scheduler. The
+    // primary rays of 2x2 pixel blocks are traced as packets into a local
+    // buffer, which is copied to the image once the tile is finished.
+    auto raytraceTiles = [&](unsigned int worker) {
+        std::vector<vec3>   buffer(tile * tile);
+        TileScheduler::Tile t;
+        while (scheduler.next(worker, t))
+        {
+            const unsigned int w = t.x1 - t.x0;
+            for (unsigned int y=t.y0; y<t.y1; y+=2)
+            {
+                for (unsigned int x=t.x0; x<t.x1; x+=2)
+                {
+                    // lanes outside the tile stay inactive
+                    RayPacket packet;
+                    for (int i=0; i<RayPacket::SIZE; ++i)
+                    {
+                        const unsigned int px = x + (i & 1), py = y + (i >> 1);
+                        if (px < t.x1 && py < t.y1)
+                            packet.set(i, camera.primary_ray(region_x + px, region_y + shard.row(py)));
+                    }
+
+                    // compute colors by tracing the packet
+                    vec3       colors[RayPacket::SIZE];
+                    Object_ptr hit[RayPacket::SIZE];
+                    trace(packet, colors, hit);
+
+                    for (int i=0; i<RayPacket::SIZE; ++i)
+                    {
+                        if (!(packet.active & (1u << i))) continue;
+                        const unsigned int px = x + (i & 1), py = y + (i >> 1);
+
+                        // avoid over-saturation and store pixel color
+                        buffer[(py - t.y0) * w + (px - t.x0)] = min(colors[i], vec3(1, 1, 1));
+                        if (!objects.empty()) objects[size_t(py) * _img.width() + px] = hit[i];
+                    }
+                }
+            }
+
+            _img.set_tile(t.x0, t.y0, w, t.y1 - t.y0, buffer.data());
+        }
+    };
+
+    // If possible, raytrace tiles in parallel, one worker per thread.
+
 #if HAVE_OPENMP
-#  include <omp.h>
+    std::cout << "Rendering with up to " << num_threads << " threads, "
+              << scheduler.num_tiles() << " tiles of " << tile << "x" << tile << " pixels." << std::endl;
+#else
+    std::cout << "Rendering singlethreaded (compiled without OpenMP)." << std::endl;
 #endif
+    parallel_for(num_threads, 1, [&](int worker) { raytraceTiles(worker); });
+
+    if (aa_samples > 1)
+        antialias(_img, objects, shard);
+}
 
 //-----------------------------------------------------------------------------
 
+namespace {
 
-Image Scene::render()
+/// hash of a pixel and sample index to [0,1), used to jitter samples
+/// reproducibly (the same image for every run and thread count)
+Scalar jitter(unsigned int _x, unsigned int _y, unsigned int _s)
+{
+    uint32_t h = _x * 0x8da6b343u ^ _y * 0xd8163841u ^ _s * 0xcb1ab31fu;
+    h ^= h >> 16;  h *= 0x7feb352du;
+    h ^= h >> 15;  h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return Scalar(h >> 8) / Scalar(1u << 24);
+}
+
+}
+
+//-----------------------------------------------------------------------------
+
+void Scene::antialias(Image& _img, const std::vector<Object_ptr>& _objects, const Shard& _shard)
+{
+    const int width  = _img.width();
+    const int height = _img.height();
+
+    // camera pixel of pixel (_x,_y) of the image
+    auto camera_pixel = [&](int _x, int _y, long& _cx, long& _cy)
+    {
+        _cx = long(region_x) + _x;
+        _cy = long(region_y) + _shard.row(_y);
+    };
+
+    // the camera pixels next to the image that are not in it, i.e., rows
+    // next to the shard's bands, which belong to other shards, and pixels
+    // around the region (see setRegion()). They are traced again like in
+    // render(), such that the pixels at band and region borders are
+    // refined as in the whole image.
+    std::vector<uint64_t> outside;
+    auto add_outside = [&](int _x, int _y, int _dx, int _dy)
+    {
+        long cx, cy;
+        camera_pixel(_x, _y, cx, cy);
+        cx += _dx;
+        cy += _dy;
+        if (cx >= 0 && cx < long(camera.width) && cy >= 0 && cy < long(camera.height))
+            outside.push_back(uint64_t(cy) * camera.width + uint64_t(cx));
+    };
+    for (int y=0; y<height; ++y)
+    {
+        const unsigned int r = _shard.row(y);
+        if (y == 0 || _shard.row(y-1) != r-1)
+            for (int x=0; x<width; ++x) add_outside(x, y, 0, -1);
+        if (y+1 == height || _shard.row(y+1) != r+1)
+            for (int x=0; x<width; ++x) add_outside(x, y, 0, 1);
+        add_outside(0, y, -1, 0);
+        add_outside(width-1, y, 1, 0);
+    }
+    std::sort(outside.begin(), outside.end());
+    outside.erase(std::unique(outside.begin(), outside.end()), outside.end());
+
+    std::vector<vec3>       outside_colors(outside.size());
+    std::vector<Object_ptr> outside_objects(outside.size());
+    const int num_packets = int((outside.size() + RayPacket::SIZE - 1) / RayPacket::SIZE);
+    parallel_for(num_packets, 16, [&](int p)
+    {
+        const int  j = p * RayPacket::SIZE;
+        const int  n = std::min<int>(RayPacket::SIZE, int(outside.size()) - j);
+        RayPacket packet;
+        for (int i=0; i<n; ++i)
+            packet.set(i, camera.primary_ray(static_cast<unsigned int>(outside[j+i] % camera.width),
+                                             static_cast<unsigned int>(outside[j+i] / camera.width)));
+        vec3       colors[RayPacket::SIZE];
+        Object_ptr hit[RayPacket::SIZE];
+        trace(packet, colors, hit);
+        for (int i=0; i<n; ++i)
+        {
+            outside_colors[j+i]  = min(colors[i], vec3(1, 1, 1));
+            outside_objects[j+i] = hit[i];
+        }
+    });
+
+    // color and object of the neighbor of pixel (_x,_y) in direction
+    // (_dx,_dy), false if the neighbor is outside the camera's image
+    auto neighbor = [&](int _x, int _y, int _dx, int _dy, vec3& _color, Object_ptr& _object)
+    {
+        const int x = _x + _dx, y = _y + _dy;
+        if (x >= 0 && x < width &&
+            (_dy == 0 || (y >= 0 && y < height && _shard.row(y) == _shard.row(_y) + _dy)))
+        {
+            _color  = _img(x, y);
+            _object = _objects[size_t(y)*width + x];
+            return true;
+        }
+        long cx, cy;
+        camera_pixel(_x, _y, cx, cy);
+        cx += _dx;
+        cy += _dy;
+        if (cx < 0 || cx >= long(camera.width) || cy < 0 || cy >= long(camera.height)) return false;
+        const size_t i = std::lower_bound(outside.begin(), outside.end(),
+                                          uint64_t(cy) * camera.width + uint64_t(cx)) - outside.begin();
+        _color  = outside_colors[i];
+        _object = outside_objects[i];
+        return true;
+    };
+
+    // a pixel is refined if it sees another object than one of its four
+    // neighbors, or if one of its color channels differs by more than
+    // aa_threshold from theirs
+    auto differs = [&](int _x, int _y, int _dx, int _dy)
+    {
+        vec3       color;
+        Object_ptr object;
+        if (!neighbor(_x, _y, _dx, _dy, color, object)) return false;
+        if (_objects[size_t(_y)*width + _x] != object) return true;
+        const vec3 d = _img(_x,_y) - color;
+        return std::max(std::abs(d[0]), std::max(std::abs(d[1]), std::abs(d[2]))) > aa_threshold;
+    };
+
+    std::vector<unsigned int> refine;
+    for (int y=0; y<height; ++y)
+        for (int x=0; x<width; ++x)
+            if (differs(x,y, -1,0) || differs(x,y, 1,0) || differs(x,y, 0,-1) || differs(x,y, 0,1))
+                refine.push_back(y*width + x);
+
+    // refined pixels are split into kx x ky strata, as close to square as
+    // possible with at most aa_samples strata (e.g. 3x1 for 3 samples, 3x2
+    // for 6), each getting one jittered sample. The stratum in the upper
+    // left corner reuses the pixel's first sample, which lies at the corner
+    // of the pixel. If there are at least two strata in each direction, the
+    // first four strata are taken from the four quadrants of the pixel; only
+    // if their samples still differ by more than aa_threshold, the remaining
+    // strata are sampled as well.
+    const unsigned int ky = static_cast<unsigned int>(std::sqrt(Scalar(aa_samples)));
+    const unsigned int kx = aa_samples / ky;
+    const unsigned int num_strata = kx * ky;
+    std::vector<unsigned int> strata = { 0 };
+    if (ky > 1)
+        strata = { 0, kx/2, (ky/2)*kx, (ky/2)*kx + kx/2 };
+    const unsigned int num_first = ky > 1 ? 4 : num_strata;
+    for (unsigned int s=1; s<num_strata; ++s)
+        if (std::find(strata.begin(), strata.end(), s) == strata.end())
+            strata.push_back(s);
+
+    // refine into a separate buffer, such that the tests above see the
+    // original colors only
+    std::vector<vec3> refined(refine.size());
+    std::vector<char> full(refine.size(), 0);
+    parallel_for(int(refine.size()), 16, [&](int i)
+    {
+        const unsigned int x = refine[i] % width;
+        const unsigned int y = refine[i] / width;
+
+        // samples depend on the pixel's position in the camera's image
+        const unsigned int cx = region_x + x;
+        const unsigned int cy = region_y + _shard.row(y);
+        auto sample = [&](unsigned int _s)
+        {
+            const Scalar dx = ((_s % kx) + jitter(cx, cy, 2*_s  )) / kx;
+            const Scalar dy = ((_s / kx) + jitter(cx, cy, 2*_s+1)) / ky;
+            return min(trace(camera.primary_ray(cx, cy, dx, dy), 0), vec3(1, 1, 1));
+        };
+
+        vec3 color = _img(x,y), lo = color, hi = color;
+        for (unsigned int s=1; s<num_first; ++s)
+        {
+            const vec3 c = sample(strata[s]);
+            color += c;
+            lo = min(lo, c);
+            hi = max(hi, c);
+        }
+
+        unsigned int n = num_first;
+        const vec3 spread = hi - lo;
+        if (n == num_strata || std::max(spread[0], std::max(spread[1], spread[2])) > aa_threshold)
+        {
+            for (; n<num_strata; ++n)
+                color += sample(strata[n]);
+            full[i] = 1;
+        }
+        refined[i] = color / Scalar(n);
+    });
+    const size_t num_full = std::count(full.begin(), full.end(), 1);
+
+    for (size_t i=0; i<refine.size(); ++i)
+        _img.set(refine[i] % width, refine[i] / width, refined[i]);
+
+    std::cout << "Antialiasing refined " << refine.size() << " of " << size_t(width)*height
+              << " pixels, " << num_full << " of them with " << num_strata << " samples." << std::endl;
+}
+
+//-----------------------------------------------------------------------------
+
+Image Scene::render_progressive(const std::function<void(const Image&, unsigned int)>& _preview)
 {
     // allocate new image.
     Image img(camera.width, camera.height);
 
-    // Function rendering a full column of the image
-    auto raytraceColumn = [&img, this](int x) {
-        for (int y=0; y<int(camera.height); ++y)
+    const int width  = camera.width;
+    const int height = camera.height;
+
+    // edge length of the blocks of the first level
+    const int first_block = 16;
+
+#if HAVE_OPENMP
+    std::cout << "Rendering progressively with up to " << parallel_threads() << " threads." << std::endl;
+#else
+    std::cout << "Rendering progressively singlethreaded (compiled without OpenMP)." << std::endl;
+#endif
+
+    for (int block=first_block; block>=1; block/=2)
+    {
+        // trace the upper left pixels of all blocks, except those that are
+        // also upper left pixels of the previous level's (twice as large) blocks
+        parallel_for((height + block - 1) / block, 1, [&](int row)
         {
-            Ray ray = camera.primary_ray(x,y);
+            const int y = row * block;
+            for (int x=0; x<width; x+=block)
+            {
+                if (block < first_block && x % (2*block) == 0 && y % (2*block) == 0)
+                    continue;
 
-            // compute color by tracing this ray
-            vec3 color = trace(ray, 0);
+                // compute color by tracing this ray, avoid over-saturation
+                img.set(x, y, min(trace(camera.primary_ray(x,y), 0), vec3(1, 1, 1)));
+            }
+        });
 
-            // avoid over-saturation
-            color = min(color, vec3(1, 1, 1));
+        if (!_preview) continue;
 
-            // store pixel color
-            img(x,y) = color;
+        // the last level has traced all pixels
+        if (block == 1)
+        {
+            _preview(img, 1);
+            continue;
         }
-    };
 
-    // If possible, raytrace image columns in parallel.
+        // fill every block with the color of its upper left pixel
+        Image preview(camera.width, camera.height);
+        parallel_for(height, 16, [&](int y)
+        {
+            for (int x=0; x<width; ++x)
+                preview.set(x, y, img(x - x % block, y - y % block));
+        });
+        _preview(preview, block);
+    }
+
+    return img;
+}
+
+//-----------------------------------------------------------------------------
+
+namespace {
+
+/// Offset of shadow ray origins along the normal, which prevents surfaces
+/// from shadowing themselves due to rounding errors of the intersection
+/// point (shadow acne). In single precision these errors are large enough
+/// to grow noticeably with the magnitude of the point's coordinates.
+Scalar shadow_offset(const vec3& _point)
+{
+#if RAYTRACE_FLOAT
+    return Scalar(1e-4) * std::max({Scalar(1), std::abs(_point[0]), std::abs(_point[1]), std::abs(_point[2])});
+#else
+    (void)_point;
+    return 0.000001;
+#endif
+}
+
+/// a ray in a queue of the wavefront renderer, tagged with the index of the
+/// pixel (primary rays) or visibility entry (shadow rays) it belongs to
+struct Ray_item
+{
+    Ray          ray;
+    Scalar       distance;
+    unsigned int index;
+    unsigned int key;
+};
+
+/// spread the lower 10 bits of \c _v such that two zero bits separate them
+unsigned int spread_bits(unsigned int _v)
+{
+    _v = (_v | (_v << 16)) & 0x030000FF;
+    _v = (_v | (_v <<  8)) & 0x0300F00F;
+    _v = (_v | (_v <<  4)) & 0x030C30C3;
+    _v = (_v | (_v <<  2)) & 0x09249249;
+    return _v;
+}
+
+/// Sort key of a ray: its direction octant in the highest bits, followed by
+/// the Morton code of the cell containing its origin in a 1024^3 grid over
+/// the box [_bb_min, _bb_max] (origins outside are clamped).
+unsigned int sort_key(const Ray& _ray, const vec3& _bb_min, const vec3& _bb_max)
+{
+    unsigned int cell[3];
+    for (int i=0; i<3; ++i)
+    {
+        const Scalar extent = _bb_max[i] - _bb_min[i];
+        const Scalar x = (extent > 0.0) ? (_ray.origin[i] - _bb_min[i]) / extent : 0.0;
+        cell[i] = static_cast<unsigned int>(std::max(0.0, std::min(1023.0, x * 1024.0)));
+    }
+    const unsigned int octant = (_ray.sign[0] << 2) | (_ray.sign[1] << 1) | _ray.sign[2];
+    return (octant << 29) | (spread_bits(cell[0]) << 2) | (spread_bits(cell[1]) << 1) | spread_bits(cell[2]);
+}
+
+/// Sort a ray queue by key, rays with equal keys keep their order. Only
+/// (key, position) pairs are sorted, each ray is then moved once.
+void sort_rays(std::vector<Ray_item>& _rays)
+{
+    std::vector<uint64_t> order(_rays.size());
+    for (size_t i=0; i<_rays.size(); ++i)
+        order[i] = (uint64_t(_rays[i].key) << 32) | i;
+    std::sort(order.begin(), order.end());
+
+    std::vector<Ray_item> sorted(_rays.size());
+    for (size_t i=0; i<order.size(); ++i)
+        sorted[i] = _rays[order[i] & 0xFFFFFFFF];
+    _rays.swap(sorted);
+}
+
+}
+
+//-----------------------------------------------------------------------------
+
+Image Scene::render_wavefront()
+{
+    // allocate new image.
+    Image img(camera.width, camera.height);
+
+    const unsigned int width   = camera.width;
+    const unsigned int npixels = camera.width * camera.height;
+    const unsigned int nlights = static_cast<unsigned int>(lights.size());
+
+    // the image is processed in waves of this many pixels, which bounds
+    // the size of the ray queues
+    const unsigned int WAVE_SIZE = 1 << 16;
 
 #if HAVE_OPENMP
-    std::cout << "Rendering with up to " << omp_get_max_threads() << " threads." << std::endl;
-#  pragma omp parallel for
+    std::cout << "Wavefront rendering with up to " << parallel_threads() << " threads." << std::endl;
 #else
-    std::cout << "Rendering singlethreaded (compiled without OpenMP)." << std::endl;
+    std::cout << "Wavefront rendering singlethreaded (compiled without OpenMP)." << std::endl;
 #endif
 
-    for (int x=0; x<int(camera.width); ++x) {
-        raytraceColumn(x);
+    // closest intersection of a primary ray
+    struct Hit
+    {
+        Object_ptr object = nullptr;
+        vec3       point;
+        vec3       normal;
+    };
+
+    std::vector<Ray_item>     rays, shadow_rays;
+    std::vector<Hit>          hits;
+    std::vector<unsigned int> hit_rays;
+    std::vector<char>         visible;
+
+    for (unsigned int wave=0; wave<npixels; wave+=WAVE_SIZE)
+    {
+        const int n = static_cast<int>(std::min(WAVE_SIZE, npixels - wave));
+
+
+        // stage 1: generate the primary rays of the wave's pixels
+        rays.resize(n);
+        parallel_for(n, 1024, [&](int i)
+        {
+            const unsigned int pixel = wave + i;
+            rays[i].ray   = camera.primary_ray(pixel % width, pixel / width);
+            rays[i].index = pixel;
+            rays[i].key   = sort_key(rays[i].ray, bb_min, bb_max);
+        });
+        sort_rays(rays);
+
+
+        // stage 2: intersect the primary rays, consecutive rays form packets
+        hits.assign(n, Hit());
+        const int npackets = (n + RayPacket::SIZE-1) / RayPacket::SIZE;
+        parallel_for(npackets, 64, [&](int p)
+        {
+            const int first = p * RayPacket::SIZE;
+            RayPacket packet;
+            for (int i=0; i<RayPacket::SIZE && first+i<n; ++i)
+            {
+                packet.set(i, rays[first+i].ray);
+            }
+
+            Object_ptr object[RayPacket::SIZE];
+            vec3       point[RayPacket::SIZE], normal[RayPacket::SIZE];
+            Scalar     t[RayPacket::SIZE];
+            const unsigned int found = intersect_packet(packet, object, point, normal, t);
+            for (int i=0; i<RayPacket::SIZE; ++i)
+                if (found & (1u << i))
+                    hits[first+i] = Hit{object[i], point[i], normal[i]};
+        });
+
+        hit_rays.clear();
+        for (int i=0; i<n; ++i)
+            if (hits[i].object) hit_rays.push_back(i);
+        const int nhits = static_cast<int>(hit_rays.size());
+
+
+        // stage 3: generate the shadow rays of all hits towards all lights.
+        // lighting() is evaluated with a visibility function that collects
+        // the shadow rays instead of tracing them; the colors are discarded.
+        shadow_rays.resize(size_t(nhits) * nlights);
+        parallel_for(nhits, 256, [&](int h)
+        {
+            const unsigned int i = hit_rays[h];
+            lighting(hits[i].point, hits[i].normal, -rays[i].ray.direction, hits[i].object->material,
+                     [&](size_t _l, const Ray& _shadow_ray, Scalar _distance)
+            {
+                Ray_item& item = shadow_rays[size_t(h)*nlights + _l];
+                item.ray      = _shadow_ray;
+                item.distance = _distance;
+                item.index    = h*nlights + static_cast<unsigned int>(_l);
+                item.key      = sort_key(_shadow_ray, bb_min, bb_max);
+                return false;
+            });
+        });
+        sort_rays(shadow_rays);
+
+
+        // stage 4: test the visibility of all lights
+        visible.assign(shadow_rays.size(), 0);
+        parallel_for(int(shadow_rays.size()), 256, [&](int s)
+        {
+            visible[shadow_rays[s].index] = !occluded(shadow_rays[s].ray, shadow_rays[s].distance);
+        });
+
+
+        // stage 5: shade all hits with the precomputed visibilities. Mirror
+        // rays would be queued here once Scene::trace computes reflections.
+        parallel_for(nhits, 256, [&](int h)
+        {
+            const unsigned int i = hit_rays[h];
+            const vec3 color = lighting(hits[i].point, hits[i].normal, -rays[i].ray.direction, hits[i].object->material,
+                                        [&](size_t _l, const Ray&, Scalar) { return visible[size_t(h)*nlights + _l] != 0; });
+
+            // avoid over-saturation and store pixel color
+            img.set(rays[i].index % width, rays[i].index / width, min(color, vec3(1, 1, 1)));
+        });
+
+        // rays that missed everything see the background
+        for (int i=0; i<n; ++i)
+            if (!hits[i].object)
+                img.set(rays[i].index % width, rays[i].index / width, min(background, vec3(1, 1, 1)));
     }
 
-    // Note: compiler will elide copy.
     return img;
 }
 
@@ -79,22 +584,52 @@ vec3 Scene::trace(const Ray& _ray, int _depth)
     Object_ptr  object;
     vec3        point;
     vec3        normal;
-    double      t;
+    Scalar      t;
     if (!intersect(_ray, object, point, normal, t))
     {
         return background;
     }
 
+    return shade(_ray, _depth, object, point, normal);
+}
+
+//-----------------------------------------------------------------------------
+
+void Scene::trace(const RayPacket& _packet, vec3 _colors[], Object_ptr _objects[])
+{
+    // find the first intersections of all rays at once
+    Object_ptr  object[RayPacket::SIZE];
+    vec3        point[RayPacket::SIZE];
+    vec3        normal[RayPacket::SIZE];
+    Scalar      t[RayPacket::SIZE];
+    const unsigned int hits = intersect_packet(_packet, object, point, normal, t);
+
+    // shading and secondary rays are computed ray by ray
+    for (int i=0; i<RayPacket::SIZE; ++i)
+    {
+        if (!(_packet.active & (1u << i))) continue;
+        _colors[i] = (hits & (1u << i))
+                   ? shade(_packet.ray[i], 0, object[i], point[i], normal[i])
+                   : background;
+        if (_objects)
+            _objects[i] = (hits & (1u << i)) ? object[i] : nullptr;
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+vec3 Scene::shade(const Ray& _ray, int /*_depth*/, const Object_ptr _object, const vec3& _point, const vec3& _normal)
+{
     // compute local Phong lighting (ambient+diffuse+specular)
-    vec3 color = lighting(point, normal, -_ray.direction, object->material);
+    vec3 color = lighting(_point, _normal, -_ray.direction, _object->material);
 
 
     /** \todo
      * Compute reflections by recursive ray tracing:
-     * - check whether `object` is reflective by checking its `material.mirror`
+     * - check whether `_object` is reflective by checking its `material.mirror`
      * - check recursion depth
      * - generate reflected ray, compute its color contribution, and mix it with
-     * the color computed by local Phong lighting (use `object->material.mirror` as weight)
+     * the color computed by local Phong lighting (use `_object->material.mirror` as weight)
      * - check whether your recursive algorithm reflects the ray `max_depth` times
      */
 
@@ -103,30 +638,130 @@ vec3 Scene::trace(const Ray& _ray, int _depth)
 
 //-----------------------------------------------------------------------------
 
-bool Scene::intersect(const Ray& _ray, Object_ptr& _object, vec3& _point, vec3& _normal, double& _t)
+bool Scene::intersect(const Ray& _ray, Object_ptr& _object, vec3& _point, vec3& _normal, Scalar& _t)
 {
-    double  t, tmin(Object::NO_INTERSECTION);
+    Scalar  t;
     vec3    p, n;
+    bool    found = false;
+
+    // the interval of this copy of the ray shrinks with every closer
+    // intersection, such that all objects behind it bail out early
+    Ray ray(_ray);
 
-    for (const auto &o: objects) // for each object
+    auto intersect_object = [&](const Object_ptr o, Ray& r)
     {
-        if (o->intersect(_ray, p, n, t)) // does ray intersect object?
+        if (o->intersect(r, p, n, t)) // does ray intersect object (closer than before)?
         {
-            if (t < tmin) // is intersection point the currently closest one?
+            r.tmax  = t;
+            _object = o;
+            _point  = p;
+            _normal = n;
+            _t      = t;
+            found   = true;
+        }
+    };
+
+    // unbounded objects are tested first, they often are the closest hit
+    // and thereby prune the traversal below
+    for (const Object_ptr o: unbounded_objects)
+        intersect_object(o, ray);
+
+    // only visit bounded objects whose BVH nodes or grid cells are hit
+    // within the ray's interval
+    auto intersect_bounded = [&](unsigned int i, Ray& r) { intersect_object(bounded_objects[i], r); };
+    if (acceleration == ACCEL_GRID)
+        grid.traverse(ray, intersect_bounded);
+    else
+        bvh.traverse(ray, intersect_bounded);
+
+    return found;
+}
+
+//-----------------------------------------------------------------------------
+
+unsigned int Scene::intersect_packet(const RayPacket& _packet, Object_ptr _object[], vec3 _point[], vec3 _normal[], Scalar _t[])
+{
+    // the grid is walked ray by ray
+    if (acceleration == ACCEL_GRID)
+    {
+        unsigned int found = 0;
+        for (int i=0; i<RayPacket::SIZE; ++i)
+            if ((_packet.active & (1u << i)) &&
+                intersect(_packet.ray[i], _object[i], _point[i], _normal[i], _t[i]))
+                found |= (1u << i);
+        return found;
+    }
+
+    vec3         p[RayPacket::SIZE], n[RayPacket::SIZE];
+    Scalar       t[RayPacket::SIZE];
+    unsigned int found = 0;
+
+    // the intervals of the copied rays shrink with every closer intersection
+    RayPacket packet(_packet);
+
+    auto intersect_object = [&](const Object_ptr o, RayPacket& r, unsigned int lanes)
+    {
+        const unsigned int hits = o->intersect_packet(r, lanes, p, n, t);
+        for (int i=0; i<RayPacket::SIZE; ++i)
+        {
+            if (hits & (1u << i))
             {
-                tmin = t;
-                _object = o.get();
-                _point  = p;
-                _normal = n;
-                _t      = t;
+                r.ray[i].tmax = t[i];
+                _object[i]    = o;
+                _point[i]     = p[i];
+                _normal[i]    = n[i];
+                _t[i]         = t[i];
             }
         }
-    }
+        found |= hits;
+    };
 
-    return (tmin != Object::NO_INTERSECTION);
+    for (const Object_ptr o: unbounded_objects)
+        intersect_object(o, packet, packet.active);
+
+    bvh.traverse_packet(packet, packet.active, [&](unsigned int node, RayPacket& r, unsigned int lanes)
+    {
+        const BVH::Node& leaf = bvh.nodes()[node];
+        for (unsigned int i=leaf.offset; i<leaf.offset+leaf.count; ++i)
+            intersect_object(bounded_objects[bvh.primitive(i)], r, lanes);
+    });
+
+    return found;
 }
 
+//-----------------------------------------------------------------------------
+
+bool Scene::occluded(const Ray& _ray, Scalar _max_distance) const
+{
+    // restrict the ray to the segment between its origin and _max_distance
+    Ray ray(_ray);
+    ray.tmax = std::min(ray.tmax, _max_distance);
+
+    for (const Object_ptr o: unbounded_objects)
+        if (o->occluded(ray)) return true;
+
+    auto occluded_bounded = [&](unsigned int i) { return bounded_objects[i]->occluded(ray); };
+    if (acceleration == ACCEL_GRID)
+        return grid.occluded(ray, occluded_bounded);
+    else
+        return bvh.occluded(ray, occluded_bounded);
+}
+
+//-----------------------------------------------------------------------------
+
 vec3 Scene::lighting(const vec3& _point, const vec3& _normal, const vec3& _view, const Material& _material)
+{
+    return lighting(_point, _normal, _view, _material, [this](size_t, const Ray& _shadow_ray, Scalar _distance)
+    {
+        return !occluded(_shadow_ray, _distance);
+    });
+}
+
+//-----------------------------------------------------------------------------
+
+template <class Visibility>
+vec3 Scene::lighting(const vec3& _point, const vec3& _normal, const vec3& _view, const Material& _material,
+                     Visibility&& _visible)
 {
     //Global ambient contribution
     vec3 ambientLight = ambience * _material.ambient;
@@ -136,25 +771,26 @@ vec3 Scene::lighting(const vec3& _point, const vec3& _normal, const vec3& _view,
 
     vec3 normal = normalize(_normal);
 
-    for (Light light : lights) {
+    for (size_t l=0; l<lights.size(); ++l) {
+        const Light& light = lights[l];
+
         //a normalized vector that points towards the light source
-        vec3 lDir = normalize(light.position - _point);
+        const vec3   toLight   = light.position - _point;
+        const Scalar lDistance = norm(toLight);
+        vec3 lDir = toLight / lDistance;
 
         //this ray will be used to check whether there are objects
         //between the point and the light source or not
-        vec3 displacement = 0.000001 * normal; //used to solve shadow acne
+        vec3 displacement = shadow_offset(_point) * normal; //used to solve shadow acne
         Ray shadowRay(_point +  displacement, lDir);
-        //things that I need only to make intersect() give me the boolean that I am looking for
-        Object_ptr o;
-        vec3 a, b;
-        double t;
 
-        //calculate diffuse and specular reflection only if the ray is not a shadow ray
-        if (!intersect(shadowRay, o, a, b, t)) {
+        //calculate diffuse and specular reflection only if the ray is not a shadow ray,
+        //objects behind the light source do not cast shadows
+        if (_visible(l, shadowRay, lDistance)) {
             //max is calculated to avoid light coming from behind
             diffuseReflection +=
                 light.color * _material.diffuse *
-                    std::max(0.0, dot(normal, lDir));
+                    std::max(Scalar(0), dot(normal, lDir));
 
             if (dot(_normal, lDir) < 0 || dot(mirror(lDir,normal),_view) < 0) {
                 //if the light comes from behind or doesn't go in the direction of the view,
@@ -222,8 +858,23 @@ void Scene::read(const std::string &_filename)
     if (!ifs)
         throw std::runtime_error("Cannot open file " + _filename);
 
+    std::vector<Keyframe> keyframes;
+    size_t num_frames = 0;
+
+    // meshes are only parsed here and loaded after the whole file
+    std::vector<Mesh*> meshes;
+    bool compact = false;
+
+    // the first mesh loaded from each file, which instances refer to
+    std::map<std::string, Mesh*> mesh_files;
+    prototypes.clear();
+
     const std::map<std::string, std::function<void(void)>> entityParser = {
         {"depth",      [&]() { ifs >> max_depth; }},
+        {"compact_meshes", [&]() { compact = true; }},
+        {"keyframe",   [&]() { Keyframe k; ifs >> k.eye >> k.center >> k.up; keyframes.push_back(k); }},
+        {"frames",     [&]() { ifs >> num_frames; }},
+        {"antialiasing", [&]() { ifs >> aa_samples >> aa_threshold; }},
         {"camera",     [&]() { ifs >> camera; }},
         {"background", [&]() { ifs >> background; }},
         {"ambience",   [&]() { ifs >> ambience; }},
@@ -231,7 +882,32 @@ void Scene::read(const std::string &_filename)
         {"plane",      [&]() { objects.emplace_back(new    Plane(ifs)); }},
         {"sphere",     [&]() { objects.emplace_back(new   Sphere(ifs)); }},
         {"cylinder",   [&]() { objects.emplace_back(new Cylinder(ifs)); }},
-        {"mesh",       [&]() { objects.emplace_back(new     Mesh(ifs, _filename)); }}
+        {"mesh",       [&]() {
+            meshes.push_back(new Mesh(ifs, _filename));
+            objects.emplace_back(meshes.back());
+            mesh_files.emplace(meshes.back()->filename(), meshes.back());
+        }},
+        {"instance",   [&]() {
+            // the mesh is shared with a `mesh` entity or previous instances
+            // of the same file, or loaded without being shown itself
+            std::string meshFile;
+            ifs >> meshFile;
+            const std::string path = Mesh::resolve_path(meshFile, _filename);
+            if (!mesh_files.count(path))
+            {
+                meshes.push_back(new Mesh(path));
+                prototypes.emplace_back(meshes.back());
+                mesh_files.emplace(path, meshes.back());
+            }
+            objects.emplace_back(new Instance(ifs, mesh_files.at(path)));
+        }},
+        {"accel",      [&]() {
+            std::string accel;
+            ifs >> accel;
+            if      (accel ==  "bvh") acceleration = ACCEL_BVH;
+            else if (accel == "grid") acceleration = ACCEL_GRID;
+            else throw std::runtime_error("Invalid acceleration structure " + accel);
+        }}
     };
 
     // parse file
@@ -246,6 +922,162 @@ void Scene::read(const std::string &_filename)
             throw std::runtime_error("Invalid token encountered: " + token);
         entityParser.at(token)();
     }
+
+    // load all meshes in parallel, the reader parallelizes each mesh
+    // further (see parallel_for()). The first error (in file order) is
+    // rethrown once all tasks are done.
+    std::vector<std::exception_ptr> errors(meshes.size());
+    parallel_for(int(meshes.size()), 1, [&](int i)
+    {
+        try
+        {
+            meshes[i]->load(acceleration);
+        }
+        catch (...)
+        {
+            errors[i] = std::current_exception();
+        }
+    });
+    for (const std::exception_ptr& e: errors)
+        if (e) std::rethrow_exception(e);
+    for (const Mesh* m: meshes)
+        std::cout << "  read " + m->filename() + ": " + std::to_string(m->num_vertices()) + " vertices, " +
+                     std::to_string(m->num_triangles()) + " triangles" + (m->cached() ? " (cached)\n" : "\n");
+    if (compact)
+        compactMeshes();
+
+    // without `frames`, every keyframe is a frame. Otherwise, the camera
+    // moves linearly from keyframe to keyframe, reaching the first one in
+    // the first frame and the last one in the last frame.
+    if (num_frames && keyframes.empty())
+        throw std::runtime_error("Scene " + _filename + " has frames but no keyframes");
+    if (!num_frames)
+        num_frames = keyframes.size();
+    camera_path.clear();
+    for (size_t f=0; f<num_frames; ++f)
+    {
+        const Scalar u = (num_frames > 1) ? Scalar(f * (keyframes.size()-1)) / Scalar(num_frames-1) : 0;
+        const size_t i = std::min(static_cast<size_t>(u), keyframes.size()-1);
+        const size_t j = std::min(i+1, keyframes.size()-1);
+        const Scalar a = u - Scalar(i);
+        const Keyframe& k0 = keyframes[i];
+        const Keyframe& k1 = keyframes[j];
+        camera_path.push_back(Keyframe{ (1-a)*k0.eye    + a*k1.eye,
+                                        (1-a)*k0.center + a*k1.center,
+                                        (1-a)*k0.up     + a*k1.up });
+    }
+
+    build_acceleration();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Scene::readCameraPath(const std::string& _filename)
+{
+    std::ifstream ifs(_filename);
+    if (!ifs)
+        throw std::runtime_error("Cannot open file " + _filename);
+
+    std::vector<Keyframe> path;
+    std::string line;
+    for (size_t lineno=1; std::getline(ifs, line); ++lineno)
+    {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+
+        std::istringstream iss(line);
+        Keyframe k;
+        if (!(iss >> k.eye >> k.center >> k.up))
+            throw std::runtime_error(_filename + ":" + std::to_string(lineno) + ": expected eye, center, and up vector");
+        path.push_back(k);
+    }
+
+    camera_path = std::move(path);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Scene::compactMeshes()
+{
+    std::vector<Mesh*> meshes;
+    for (const auto& objs: { &objects, &prototypes })
+        for (const auto& o: *objs)
+            if (Mesh* m = dynamic_cast<Mesh*>(o.get()))
+                meshes.push_back(m);
+
+    size_t triangles = 0, before = 0, after = 0;
+    for (Mesh* m: meshes)
+    {
+        triangles += m->num_triangles();
+        before    += m->memory();
+        m->compact();
+        after     += m->memory();
+    }
+
+    if (triangles)
+        std::cout << "  compact meshes: " + std::to_string(before / triangles) + " -> " +
+                     std::to_string(after / triangles) + " bytes per triangle\n";
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Scene::setFrame(size_t _frame)
+{
+    const Keyframe& k = camera_path.at(_frame);
+    camera.eye    = k.eye;
+    camera.center = k.center;
+    camera.up     = k.up;
+    camera.init();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Scene::build_acceleration()
+{
+    for (const auto &p: prototypes)
+        p->set_acceleration(acceleration);
+
+    bounded_objects.clear();
+    unbounded_objects.clear();
+
+    bb_min = vec3(std::numeric_limits<Scalar>::max());
+    bb_max = vec3(std::numeric_limits<Scalar>::lowest());
+
+    std::vector<vec3> bounds_min, bounds_max;
+    for (const auto &o: objects)
+    {
+        o->set_acceleration(acceleration);
+
+        vec3 omin, omax;
+        if (o->bounds(omin, omax))
+        {
+            bounded_objects.push_back(o.get());
+            bounds_min.push_back(omin);
+            bounds_max.push_back(omax);
+            bb_min = min(bb_min, omin);
+            bb_max = max(bb_max, omax);
+        }
+        else
+        {
+            unbounded_objects.push_back(o.get());
+        }
+    }
+
+    bvh  = BVH();
+    grid = Grid();
+    if (acceleration == ACCEL_GRID)
+        grid.build(bounds_min, bounds_max);
+    else
+        bvh.build(bounds_min, bounds_max);
 }
 
 
@@ -17,10 +17,15 @@
 #include "Object.h"
 #include "Light.h"
 #include "Ray.h"
+#include "RayPacket.h"
 #include "Material.h"
 #include "Image.h"
+#include "Shard.h"
 #include "Camera.h"
+#include "BVH.h"
+#include "Grid.h"
 
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -36,9 +41,83 @@ public:
         read(path);
     }
 
-    /// Allocate image and raytrace the scene.
+    /// Allocate image and raytrace the scene. The image is split into
+    /// square tiles of getTileSize() pixels, which are distributed among
+    /// the threads by a TileScheduler.
     Image  render();
 
+    /// Raytrace the scene like render(), but into \c _img, which has to have
+    /// the camera's resolution. This allows to choose the image's storage,
+    /// e.g. to render directly into a file with Image::map().
+    void   render(Image& _img);
+
+    /// Allocate image and raytrace the scene progressively from coarse to
+    /// fine: first one ray per 16x16 block of pixels, then one per 8x8 block,
+    /// and so on down to one ray per pixel. Pixels traced at a coarser level
+    /// are reused, such that the final image costs no more rays than render().
+    /// After each level, `_preview(image, block)` is called with an image in
+    /// which every block has the color of its traced (upper left) pixel.
+    Image  render_progressive(const std::function<void(const Image&, unsigned int)>& _preview);
+
+    /// Configure adaptive antialiasing in render(): pixels whose color differs
+    /// from a neighbor's by more than the threshold (see
+    /// setAntialiasingThreshold()), or that see another object than a
+    /// neighbor, are supersampled with up to _samples stratified samples.
+    /// _samples <= 1 disables antialiasing.
+    void setAntialiasing(unsigned int _samples) { aa_samples = _samples; }
+
+    /// Maximum number of samples per pixel for antialiasing (<= 1: off).
+    unsigned int antialiasingSamples() const { return aa_samples; }
+
+    /// Set the color difference (in any channel) between neighboring pixels
+    /// that triggers antialiasing (see setAntialiasing()).
+    void setAntialiasingThreshold(Scalar _threshold) { aa_threshold = _threshold; }
+
+    /// Set the edge length (in pixels) of the tiles render() works on.
+    void setTileSize(unsigned int _size) { tile_size = _size; }
+
+    /// Edge length (in pixels) of the tiles render() works on.
+    unsigned int getTileSize() const { return tile_size; }
+
+    /// Let render() trace only shard `_index` of `_count` (see Shard), i.e.,
+    /// bands of tile rows dealt round-robin to `_count` processes, which
+    /// render the image together. The bands of the tile size are the same
+    /// for all shards, as long as they use the same tile size.
+    void setShard(unsigned int _index, unsigned int _count)
+    {
+        shard_index = _index;
+        shard_count = _count;
+    }
+
+    /// The shard render() traces, which covers the whole image (or region,
+    /// see setRegion()) unless set by setShard().
+    Shard getShard() const
+    {
+        return Shard(regionWidth(), regionHeight(), tileSize(), shard_index, shard_count);
+    }
+
+    /// Let render() trace only the region of `_width` x `_height` pixels
+    /// of the camera's image whose lower left pixel is (`_x`,`_y`), e.g. to
+    /// update part of an interactive preview. The region's pixels are the
+    /// same as in the whole image, also where they are antialiased. Shards
+    /// split the region instead of the whole image. A region of size 0 (the
+    /// default) is the whole image.
+    void setRegion(unsigned int _x, unsigned int _y, unsigned int _width, unsigned int _height)
+    {
+        region_x      = _x;
+        region_y      = _y;
+        region_width  = _width;
+        region_height = _height;
+    }
+
+    /// Allocate image and raytrace the scene in stages (wavefront rendering):
+    /// all primary rays are generated, then intersected in packets, then
+    /// all shadow rays are generated and tested, and finally all hits are
+    /// shaded. The ray queues are sorted between the stages by direction
+    /// octant and origin cell, such that consecutive rays access the same
+    /// objects. Produces the same image as render().
+    Image  render_wavefront();
+
     /// Determine the color seen by a viewing ray
     /**
     *    @param[in] _ray passed Ray
@@ -47,6 +126,23 @@ public:
     **/    
     vec3  trace(const Ray& _ray, int _depth);
 
+    /// Determine the colors seen by the primary rays of a packet
+    /**
+    *    @param[in] _packet the rays, only lanes in `_packet.active` are traced
+    *    @param[out] _colors the color of each active lane
+    *    @param[out] _objects if given, the object hit by each active lane (nullptr for the background)
+    **/
+    void  trace(const RayPacket& _packet, vec3 _colors[], Object_ptr _objects[] = nullptr);
+
+    /// Determine the color at the intersection of a viewing ray with an object
+    /**
+    *    @param[in] _ray the viewing ray
+    *    @param[in] _depth recursion depth of `_ray`, as in trace()
+    *    @param[in] _object, _point, _normal the closest intersection of `_ray`, as computed by intersect()
+    *    @return    color
+    **/
+    vec3  shade(const Ray& _ray, int _depth, const Object_ptr _object, const vec3& _point, const vec3& _normal);
+
     /// Computes the closest intersection point between a ray and all objects in the scene.
     /**
     *       @param _ray Ray that should be tested for intersections with all objects in the scene.
@@ -56,7 +152,26 @@ public:
     *       @param _t returns distance between the `_ray`'s origin and `_point`
     *       @return returns `true`, if there is an intersection point between `_ray` and at least one object in the scene.
     **/
-    bool  intersect(const Ray& _ray, Object_ptr&, vec3& _point, vec3& _normal, double& _t);
+    bool  intersect(const Ray& _ray, Object_ptr&, vec3& _point, vec3& _normal, Scalar& _t);
+
+    /// Computes the closest intersection points between the rays of a packet and all objects in the scene.
+    /// The acceleration structure is traversed once for all rays of the packet.
+    /**
+    *       @param _packet rays that should be tested, only lanes in `_packet.active` are considered.
+    *       @param _object, _point, _normal, _t arrays of RayPacket::SIZE entries, entry i holds the result of intersect() for lane i.
+    *       @return returns the mask of lanes that intersect at least one object in the scene.
+    **/
+    unsigned int intersect_packet(const RayPacket& _packet, Object_ptr _object[], vec3 _point[], vec3 _normal[], Scalar _t[]);
+
+    /// Checks whether any object in the scene blocks a ray within a given distance.
+    /// Returns on the first blocker found and neither computes intersection
+    /// points nor normals, which makes it the right query for shadow rays.
+    /**
+    *       @param _ray Ray that should be tested for occluders.
+    *       @param _max_distance only objects closer than this to the `_ray`'s origin count, e.g. the distance to a light source.
+    *       @return returns `true`, if at least one object intersects `_ray` closer than `_max_distance`.
+    **/
+    bool  occluded(const Ray& _ray, Scalar _max_distance) const;
 
     /// Computes the phong lighting for a given object intersection
     /**
@@ -67,24 +182,132 @@ public:
     */
     vec3  lighting(const vec3& _point, const vec3& _normal, const vec3& _view, const Material& _material);
 
+private:
+    /// Computes the phong lighting like lighting(), but calls `_visible(l, shadow_ray, distance)`
+    /// to decide whether light `lights[l]` illuminates `_point`, e.g. to use precomputed visibilities.
+    template <class Visibility>
+    vec3  lighting(const vec3& _point, const vec3& _normal, const vec3& _view, const Material& _material,
+                   Visibility&& _visible);
+
+    /// Supersample the pixels of `_img` at object boundaries and color edges
+    /// (see setAntialiasing()). `_objects` holds the object seen through each
+    /// pixel, `_shard` maps the rows of `_img` to rows of the region (see
+    /// setRegion()).
+    void  antialias(Image& _img, const std::vector<Object_ptr>& _objects, const Shard& _shard);
+
+    /// Size of the region render() traces, see setRegion().
+    unsigned int regionWidth()  const { return region_width  ? region_width  : camera.width;  }
+    unsigned int regionHeight() const { return region_height ? region_height : camera.height; }
+
+    /// Edge length of the tiles, rounded up to an even number of pixels,
+    /// such that 2x2 packets do not straddle tiles.
+    unsigned int tileSize() const { return std::max(2u, tile_size + (tile_size & 1)); }
+
+public:
+
     void read(const std::string &filename);
 
+    /// Build the acceleration structure (BVH or uniform grid) over all
+    /// bounded objects, and let all objects build their own structures.
+    void build_acceleration();
+
     size_t numObjects() const { return objects.size(); }
 
+    /// Switch all meshes to their compact representation (see
+    /// Mesh::compact()) and report their memory per triangle before and
+    /// after. Also done by a `compact_meshes` entry in the scene file.
+    void compactMeshes();
+
+    /// Number of frames of the camera path, which is given by `keyframe`
+    /// (and `frames`) entries of the scene file or by readCameraPath().
+    /// 0 if the scene is a still image.
+    size_t numFrames() const { return camera_path.size(); }
+
+    /// Move the camera to frame `_frame` (0 <= _frame < numFrames()) of the
+    /// camera path. Objects and acceleration structures are kept, such that
+    /// rendering a sequence loads and builds the scene only once.
+    void setFrame(size_t _frame);
+
+    /// Read a camera path from a file holding one frame per line: eye,
+    /// center, and up vector (nine numbers). Lines starting with `#` are
+    /// ignored. The field of view and image size of the scene's camera are
+    /// kept. Replaces the keyframes of the scene file.
+    void readCameraPath(const std::string& _filename);
+
     // Accessors for scene objects and camera for debugging.
     const std::vector<std::unique_ptr<Object>> &getObjects() const { return objects; }
     const Camera &getCamera() const { return camera; }
+    const std::vector<Light> &getLights() const { return lights; }
+
+    /// Replace the camera, e.g. to move it between renderings of an
+    /// interactive preview. Objects and acceleration structures are kept.
+    void setCamera(const Camera& _camera) { camera = _camera; }
+
+    /// Replace light `_index` (0 <= _index < getLights().size()). Throws
+    /// std::out_of_range for other indices.
+    void setLight(size_t _index, const Light& _light) { lights.at(_index) = _light; }
+
+    /// Replace the material of object `_object` (0 <= _object <
+    /// getObjects().size()). Throws std::out_of_range for other indices.
+    void setMaterial(size_t _object, const Material& _material) { objects.at(_object)->material = _material; }
 
 private:
     /// camera stores eye position, view direction, and can generate primary rays
     Camera camera;
 
+    /// position and orientation of the camera in one frame of an animation
+    struct Keyframe
+    {
+        vec3 eye, center, up;
+    };
+
+    /// the camera of each frame of an animation (empty for a still image)
+    std::vector<Keyframe> camera_path;
+
     /// array for all lights in the scene
     std::vector<Light> lights;
 
     /// array for all the objects in the scene
     std::vector<std::unique_ptr<Object>> objects;
 
+    /// meshes that are only shown through instances (not part of objects)
+    std::vector<std::unique_ptr<Object>> prototypes;
+
+    /// objects with a bounding box, in the order indexed by bvh and grid
+    std::vector<Object_ptr> bounded_objects;
+
+    /// unbounded objects (e.g. planes) that are tested separately
+    std::vector<Object_ptr> unbounded_objects;
+
+    /// acceleration structure used for the scene and its meshes
+    Acceleration acceleration = ACCEL_BVH;
+
+    /// bounding box of bounded_objects, used to sort rays by origin
+    vec3 bb_min, bb_max;
+
+    /// bounding volume hierarchy over bounded_objects
+    BVH bvh;
+
+    /// uniform grid over bounded_objects
+    Grid grid;
+
+    /// edge length of the tiles render() distributes among threads
+    unsigned int tile_size = 32;
+
+    /// the shard render() traces, see setShard()
+    unsigned int shard_index = 0;
+    unsigned int shard_count = 1;
+
+    /// the region render() traces, see setRegion()
+    unsigned int region_x = 0, region_y = 0;
+    unsigned int region_width = 0, region_height = 0;
+
+    /// maximum number of samples per pixel for antialiasing (1: off)
+    unsigned int aa_samples = 1;
+
+    /// color difference between neighboring pixels that triggers antialiasing
+    Scalar aa_threshold = 0.1;
+
     /// max recursion depth for mirroring
     int max_depth = 0;
 
@@ -0,0 +1,199 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "Shard.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+/// the pixels of shard files are stored as little-endian floats
+void check_endianness()
+{
+    const uint16_t endian = 1;
+    if (*reinterpret_cast<const unsigned char*>(&endian) != 1)
+        throw std::runtime_error("Shard files are only supported on little-endian machines");
+}
+
+/// Parse the header of shard file \c _file and return the shard it holds
+/// and the offset of its pixels. Throws std::runtime_error if the header
+/// or the size of the file is invalid.
+Shard read_header(const std::string& _filename, const MappedFile& _file, size_t& _offset)
+{
+    // the header is a single line
+    const char* data = _file.data();
+    const char* end  = data ? static_cast<const char*>(std::memchr(data, '\n', std::min<size_t>(_file.size(), 256)))
+                            : nullptr;
+    if (!end)
+        throw std::runtime_error(_filename + ": not a shard file");
+
+    const std::string header(data, end);
+    unsigned int width, height, band, index, count;
+    char         magic[8];
+    if (std::sscanf(header.c_str(), "%7s %u %u %u %u %u", magic, &width, &height, &band, &index, &count) != 6 ||
+        std::strcmp(magic, "RTSHARD") != 0)
+        throw std::runtime_error(_filename + ": not a shard file");
+
+    Shard shard(width, height, band, index, count);
+    _offset = header.size() + 1;
+    if (_file.size() != _offset + size_t(shard.rows()) * width * 3 * sizeof(float))
+        throw std::runtime_error(_filename + ": shard file is truncated");
+    return shard;
+}
+
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+Shard::Shard(unsigned int _width, unsigned int _height, unsigned int _band,
+             unsigned int _index, unsigned int _count)
+: width_(_width), height_(_height), band_(_band), index_(_index), count_(_count)
+{
+    if (band_ == 0 || count_ == 0 || index_ >= count_)
+        throw std::runtime_error("Invalid shard " + std::to_string(index_) + "/" + std::to_string(count_));
+
+    // bands index_, index_ + count_, ..., of which only the last band of
+    // the image may have less than band_ rows
+    const size_t bands = (size_t(height_) + band_ - 1) / band_;
+    const size_t mine  = (bands > index_) ? (bands - index_ + count_ - 1) / count_ : 0;
+    rows_ = static_cast<unsigned int>(mine * band_);
+    if (bands > 0 && (bands - 1) % count_ == index_)
+        rows_ -= static_cast<unsigned int>(bands * band_ - height_);
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Shard::parse(const std::string& _shard, unsigned int& _index, unsigned int& _count)
+{
+    char end;
+    if (std::sscanf(_shard.c_str(), "%u/%u%c", &_index, &_count, &end) != 2 || _index >= _count)
+        throw std::runtime_error("Invalid shard '" + _shard + "', expected k/N with 0 <= k < N");
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Shard::write(const std::string& _filename, const Image& _image) const
+{
+    check_endianness();
+    if (_image.width() != width_ || _image.height() != rows_)
+        throw std::runtime_error("Image size does not match shard " + std::to_string(index_) + "/" + std::to_string(count_));
+
+    char header[128];
+    const int h = std::snprintf(header, sizeof(header), "RTSHARD %u %u %u %u %u\n", width_, height_, band_, index_, count_);
+
+    std::vector<float> row(3 * size_t(width_));
+    FILE* file = std::fopen(_filename.c_str(), "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(header, 1, h, file) == size_t(h);
+    for (unsigned int y=0; ok && y<rows_; ++y)
+    {
+        for (unsigned int x=0; x<width_; ++x)
+        {
+            const vec3 c = _image(x, y);
+            row[3*x]   = float(c[0]);
+            row[3*x+1] = float(c[1]);
+            row[3*x+2] = float(c[2]);
+        }
+        ok = std::fwrite(row.data(), sizeof(float), row.size(), file) == row.size();
+    }
+    return (std::fclose(file) == 0) && ok;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Shard::size(const std::string& _filename, unsigned int& _width, unsigned int& _height)
+{
+    MappedFile file;
+    if (!file.open(_filename))
+        throw std::runtime_error("Cannot open shard file " + _filename);
+    size_t      offset;
+    const Shard shard = read_header(_filename, file, offset);
+    _width  = shard.width();
+    _height = shard.height();
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+void Shard::merge(const std::vector<std::string>& _filenames, Image& _image)
+{
+    check_endianness();
+
+    std::vector<bool> merged;
+    std::vector<vec3> row(_image.width());
+    Shard             first;
+    for (const std::string& filename: _filenames)
+    {
+        MappedFile file;
+        if (!file.open(filename))
+            throw std::runtime_error("Cannot open shard file " + filename);
+        size_t      offset;
+        const Shard shard = read_header(filename, file, offset);
+
+        // all shards have to split the same image the same way
+        if (merged.empty())
+        {
+            first = shard;
+            merged.assign(shard.count_, false);
+            if (_image.width() != shard.width_ || _image.height() != shard.height_)
+                throw std::runtime_error(filename + ": shard size does not match the image size");
+        }
+        else if (shard.width_ != first.width_ || shard.height_ != first.height_ ||
+                 shard.band_  != first.band_  || shard.count_  != first.count_)
+        {
+            throw std::runtime_error(filename + ": shard does not belong to the same image as " + _filenames[0]);
+        }
+        if (merged[shard.index_])
+            throw std::runtime_error(filename + ": shard " + std::to_string(shard.index_) + " is given twice");
+        merged[shard.index_] = true;
+
+        // copy the rows, which are released from memory again if the image
+        // is stored in a file
+        const char* pixels = file.data() + offset;
+        for (unsigned int y=0; y<shard.rows_; ++y)
+        {
+            for (unsigned int x=0; x<shard.width_; ++x)
+            {
+                float c[3];
+                std::memcpy(c, pixels + (size_t(y) * shard.width_ + x) * sizeof(c), sizeof(c));
+                row[x] = vec3(c[0], c[1], c[2]);
+            }
+            _image.set_tile(0, shard.row(y), shard.width_, 1, row.data());
+        }
+    }
+
+    for (unsigned int i=0; i<merged.size(); ++i)
+        if (!merged[i])
+            throw std::runtime_error("Shard " + std::to_string(i) + "/" + std::to_string(merged.size()) + " is missing");
+    if (merged.empty())
+        throw std::runtime_error("No shard files to merge");
+}
+
+
+//=============================================================================
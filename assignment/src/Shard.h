@@ -0,0 +1,112 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef SHARD_H
+#define SHARD_H
+
+
+//== INCLUDES =================================================================
+
+#include "Image.h"
+#include <string>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class Shard Shard.h
+/// This class describes the part of an image that one of several
+/// independent processes renders (e.g. on different machines sharing a
+/// file system). The image is split into horizontal bands of a fixed
+/// height, which are dealt to the shards round-robin, such that each shard
+/// gets a similar share of expensive and cheap image regions. A shard's
+/// image holds its bands stacked from bottom to top.
+///
+/// Shards are stored in shard files (see write()), which merge() assembles
+/// into the full image. A shard file holds a text header
+/// `RTSHARD <width> <height> <band> <index> <count>` followed by a line
+/// break and the shard's pixels as 32-bit floats (RGB, little endian, row
+/// by row from the bottom), such that merging does not change any color.
+class Shard
+{
+public:
+
+    /// Shard \c _index of \c _count of an image of \c _width x \c _height
+    /// pixels split into bands of \c _band rows. Throws std::runtime_error
+    /// for invalid arguments.
+    Shard(unsigned int _width = 0, unsigned int _height = 0, unsigned int _band = 32,
+          unsigned int _index = 0, unsigned int _count = 1);
+
+    /// Parse a shard description "k/N" (0 <= k < N). Throws
+    /// std::runtime_error if \c _shard is invalid.
+    static void parse(const std::string& _shard, unsigned int& _index, unsigned int& _count);
+
+    /// width of the image (and of the shard's image)
+    unsigned int width() const { return width_; }
+
+    /// height of the full image
+    unsigned int height() const { return height_; }
+
+    /// index of the shard
+    unsigned int index() const { return index_; }
+
+    /// number of shards
+    unsigned int count() const { return count_; }
+
+    /// number of rows of the shard's image
+    unsigned int rows() const { return rows_; }
+
+    /// row of the full image that is stored in row \c _y of the shard's image
+    unsigned int row(unsigned int _y) const
+    {
+        return ((_y / band_) * count_ + index_) * band_ + _y % band_;
+    }
+
+    /// Write \c _image, which holds the shard's rows, to shard file
+    /// \c _filename. Returns whether the file could be written.
+    bool write(const std::string& _filename, const Image& _image) const;
+
+    /// Read the shard files \c _filenames (one per shard, in any order) and
+    /// copy their rows into \c _image, which has to have the full image's
+    /// size (e.g. set by Image::map() to merge out-of-core). Throws
+    /// std::runtime_error if a file is invalid, shards are missing or
+    /// duplicated, or the shards belong to different images.
+    static void merge(const std::vector<std::string>& _filenames, Image& _image);
+
+    /// Read the size of the full image from shard file \c _filename.
+    /// Throws std::runtime_error if the file is invalid.
+    static void size(const std::string& _filename, unsigned int& _width, unsigned int& _height);
+
+private:
+
+    /// width of the image
+    unsigned int width_;
+
+    /// height of the full image
+    unsigned int height_;
+
+    /// number of rows per band
+    unsigned int band_;
+
+    /// index of the shard
+    unsigned int index_;
+
+    /// number of shards
+    unsigned int count_;
+
+    /// number of rows of the shard's image
+    unsigned int rows_;
+};
+
+
+//=============================================================================
+#endif // SHARD_H defined
+//=============================================================================
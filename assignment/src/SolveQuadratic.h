@@ -11,20 +11,23 @@
 
 #ifndef SOLVEQUADRATIC_H
 #define SOLVEQUADRATIC_H
+#include "vec3.h"
 #include <cmath>
 #include <array>
 
 /// Numerically robust solution to (possibly degenerate) quadratic equations.
 /// Avoids catastrophic cancellation and handles equations that have
-/// degenerated to become linear or constant.
+/// degenerated to become linear or constant. The computation is always
+/// carried out in double precision, since the discriminant suffers from
+/// cancellation when Scalar is float.
 /// @param[in]   a,b,c    coefficients of ax^2 + bx + c == 0
 /// @param[out]  solns    array holding between 0 and 2 solutions
 /// @return      number of solutions found
-inline size_t solveQuadratic(double a, double b, double c, std::array<double, 2> &solns) {
+inline size_t solveQuadratic(double a, double b, double c, std::array<Scalar, 2> &solns) {
     // Handle degenerate (linear) case
     if (std::abs(a) < 1e-10) {
         if (std::abs(b) < 1e-10) return 0;
-        solns[0] = - c / b;
+        solns[0] = Scalar(- c / b);
         return 1;
     }
 
@@ -38,7 +41,7 @@ inline size_t solveQuadratic(double a, double b, double c, std::array<double, 2>
     //      a * x1 * x2 = c
     double a_x1 = -0.5 * (b + copysign(std::sqrt(discriminant), b));
 
-    solns = { a_x1 / a, c / a_x1 };
+    solns = { Scalar(a_x1 / a), Scalar(c / a_x1) };
     return 2;
 }
 
@@ -17,7 +17,7 @@
 //== IMPLEMENTATION =========================================================
 
 
-Sphere::Sphere(const vec3& _center, double _radius)
+Sphere::Sphere(const vec3& _center, Scalar _radius)
 : center(_center), radius(_radius)
 {
 }
@@ -31,22 +31,23 @@ Sphere::
 intersect(const Ray&  _ray,
           vec3&       _intersection_point,
           vec3&       _intersection_normal,
-          double&     _intersection_t) const
+          Scalar&     _intersection_t) const
 {
 
     const vec3 &dir = _ray.direction;
     const vec3   oc = _ray.origin - center;
 
-    std::array<double, 2> t;
+    std::array<Scalar, 2> t;
     size_t nsol = solveQuadratic(dot(dir, dir),
                                  2 * dot(dir, oc),
                                  dot(oc, oc) - radius * radius, t);
 
     _intersection_t = NO_INTERSECTION;
 
-    // Find the closest valid solution (in front of the viewer)
+    // Find the closest valid solution (within the ray's interval)
     for (size_t i = 0; i < nsol; ++i) {
-        if (t[i] > 0) _intersection_t = std::min(_intersection_t, t[i]);
+        if (t[i] > _ray.tmin && t[i] < _ray.tmax)
+            _intersection_t = std::min(_intersection_t, t[i]);
     }
 
     if (_intersection_t == NO_INTERSECTION) return false;
@@ -57,4 +58,82 @@ intersect(const Ray&  _ray,
     return true;
 }
 
+
+//-----------------------------------------------------------------------------
+
+
+unsigned int
+Sphere::
+intersect_packet(const RayPacket& _packet,
+                 unsigned int     _mask,
+                 vec3             _intersection_point[],
+                 vec3             _intersection_normal[],
+                 Scalar           _intersection_t[]) const
+{
+    // coefficients of the quadratic equations of all rays
+    const vec3xN<RayPacket::SIZE> dir = _packet.directions;
+    const vec3xN<RayPacket::SIZE>  oc = _packet.origins - center;
+
+    const scalarN<RayPacket::SIZE> a = dot(dir, dir);
+    const scalarN<RayPacket::SIZE> b = Scalar(2) * dot(dir, oc);
+    const scalarN<RayPacket::SIZE> c = dot(oc, oc) - radius * radius;
+
+    unsigned int hits = 0;
+    for (int l=0; l<RayPacket::SIZE; ++l)
+    {
+        if (!(_mask & (1u << l))) continue;
+        const Ray& ray = _packet.ray[l];
+
+        std::array<Scalar, 2> t;
+        size_t nsol = solveQuadratic(a[l], b[l], c[l], t);
+
+        // Find the closest valid solution (within the ray's interval)
+        Scalar tmin = NO_INTERSECTION;
+        for (size_t i = 0; i < nsol; ++i) {
+            if (t[i] > ray.tmin && t[i] < ray.tmax)
+                tmin = std::min(tmin, t[i]);
+        }
+        if (tmin == NO_INTERSECTION) continue;
+
+        _intersection_t[l]      = tmin;
+        _intersection_point[l]  = ray(tmin);
+        _intersection_normal[l] = (_intersection_point[l] - center) / radius;
+        hits |= (1u << l);
+    }
+    return hits;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Sphere::occluded(const Ray& _ray) const
+{
+    const vec3 &dir = _ray.direction;
+    const vec3   oc = _ray.origin - center;
+
+    std::array<Scalar, 2> t;
+    size_t nsol = solveQuadratic(dot(dir, dir),
+                                 2 * dot(dir, oc),
+                                 dot(oc, oc) - radius * radius, t);
+
+    // any solution within the ray's interval will do
+    for (size_t i = 0; i < nsol; ++i) {
+        if (t[i] > _ray.tmin && t[i] < _ray.tmax) return true;
+    }
+
+    return false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool Sphere::bounds(vec3& _bb_min, vec3& _bb_max) const
+{
+    _bb_min = center - vec3(radius);
+    _bb_max = center + vec3(radius);
+    return true;
+}
+
 //=============================================================================
@@ -28,7 +28,7 @@ class Sphere : public Object
 {
 public:
     /// Construct a sphere by specifying center and radius
-    Sphere(const vec3& _center=vec3(0,0,0), double _radius=1);
+    Sphere(const vec3& _center=vec3(0,0,0), Scalar _radius=1);
 
     /// Construct a sphere with parameters parsed from an input stream.
     Sphere(std::istream &is) { parse(is); }
@@ -43,7 +43,24 @@ public:
     virtual bool intersect(const Ray&  _ray,
                            vec3&       _intersection_point,
                            vec3&       _intersection_normal,
-                           double&     _intersection_t) const override;
+                           Scalar&     _intersection_t) const override;
+
+    /// Intersect the sphere with the rays of \c _packet selected by \c _mask,
+    /// computing the quadratic equations of all rays at once.
+    /// This function overrides Object::intersect_packet().
+    virtual unsigned int intersect_packet(const RayPacket& _packet,
+                                          unsigned int     _mask,
+                                          vec3             _intersection_point[],
+                                          vec3             _intersection_normal[],
+                                          Scalar           _intersection_t[]) const override;
+
+    /// Does \c _ray hit the sphere within its interval?
+    /// This function overrides Object::occluded().
+    virtual bool occluded(const Ray& _ray) const override;
+
+    /// Compute the bounding box of the sphere.
+    /// This function overrides Object::bounds().
+    virtual bool bounds(vec3& _bb_min, vec3& _bb_max) const override;
 
     /// parse sphere from an input stream
     virtual void parse(std::istream &is) override {
@@ -55,7 +72,7 @@ private:
     vec3   center;
 
     /// radius of the sphere
-    double radius;
+    Scalar radius;
 };
 
 //=============================================================================
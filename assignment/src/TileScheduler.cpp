@@ -0,0 +1,128 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== INCLUDES =================================================================
+
+#include "TileScheduler.h"
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+
+
+//== IMPLEMENTATION ===========================================================
+
+
+namespace {
+
+/// spread the lower 16 bits of \c _v such that a zero bit separates them
+uint32_t spread_bits(uint32_t _v)
+{
+    _v = (_v | (_v << 8)) & 0x00FF00FF;
+    _v = (_v | (_v << 4)) & 0x0F0F0F0F;
+    _v = (_v | (_v << 2)) & 0x33333333;
+    _v = (_v | (_v << 1)) & 0x55555555;
+    return _v;
+}
+
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+TileScheduler::TileScheduler(unsigned int _width, unsigned int _height,
+                             unsigned int _tile_size, unsigned int _num_workers)
+{
+    _tile_size   = std::max(1u, _tile_size);
+    _num_workers = std::max(1u, _num_workers);
+
+    // all tiles, sorted by the Morton code of their tile coordinates
+    std::vector<std::pair<uint32_t, Tile>> sorted;
+    for (unsigned int y=0; y<_height; y+=_tile_size)
+    {
+        for (unsigned int x=0; x<_width; x+=_tile_size)
+        {
+            const uint32_t code = spread_bits(x / _tile_size) | (spread_bits(y / _tile_size) << 1);
+            sorted.emplace_back(code, Tile{x, y, std::min(x+_tile_size, _width), std::min(y+_tile_size, _height)});
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(),
+              [](const std::pair<uint32_t, Tile>& _a, const std::pair<uint32_t, Tile>& _b)
+              { return _a.first < _b.first; });
+
+    tiles_.reserve(sorted.size());
+    for (const auto& t: sorted)
+        tiles_.push_back(t.second);
+
+    // deal contiguous ranges of the Morton order to the workers
+    queues_.resize(_num_workers);
+    for (unsigned int w=0; w<_num_workers; ++w)
+    {
+        queues_[w].reset(new Queue);
+        const size_t begin = tiles_.size() *  w    / _num_workers;
+        const size_t end   = tiles_.size() * (w+1) / _num_workers;
+        for (size_t i=begin; i<end; ++i)
+            queues_[w]->tiles.push_back(static_cast<unsigned int>(i));
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+bool TileScheduler::next(unsigned int _worker, Tile& _tile)
+{
+    // take the next tile of the own queue
+    {
+        Queue& own = *queues_[_worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tiles.empty())
+        {
+            _tile = tiles_[own.tiles.front()];
+            own.tiles.pop_front();
+            return true;
+        }
+    }
+
+    // steal from the back of the other queues, i.e., the tiles their
+    // owners would have rendered last
+    for (size_t i=1; i<queues_.size(); ++i)
+    {
+        Queue& victim = *queues_[(_worker + i) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tiles.empty())
+        {
+            _tile = tiles_[victim.tiles.back()];
+            victim.tiles.pop_back();
+            ++victim.steals;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+size_t TileScheduler::num_steals() const
+{
+    size_t steals = 0;
+    for (const auto& q: queues_)
+    {
+        std::lock_guard<std::mutex> lock(q->mutex);
+        steals += q->steals;
+    }
+    return steals;
+}
+
+
+//=============================================================================
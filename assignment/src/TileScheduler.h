@@ -0,0 +1,82 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef TILESCHEDULER_H
+#define TILESCHEDULER_H
+
+
+//== INCLUDES =================================================================
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \class TileScheduler TileScheduler.h
+/// This class distributes the square tiles of an image among a number of
+/// worker threads. The tiles are ordered along a Morton (Z-order) curve, such
+/// that consecutive tiles are neighbors in the image, and every worker gets
+/// a contiguous range of this order in its own queue. A worker whose queue
+/// runs empty steals tiles from the back of the other workers' queues, which
+/// balances the load when some image regions are much more expensive than
+/// others.
+class TileScheduler
+{
+public:
+
+    /// a rectangular range of pixels [x0, x1) x [y0, y1)
+    struct Tile
+    {
+        unsigned int x0, y0, x1, y1;
+    };
+
+    /// Cover an image of _width x _height pixels with tiles of
+    /// _tile_size x _tile_size pixels (smaller at the right and bottom
+    /// borders) and deal them to _num_workers queues.
+    TileScheduler(unsigned int _width, unsigned int _height,
+                  unsigned int _tile_size, unsigned int _num_workers);
+
+    /// Get the next tile for worker \c _worker (0 <= _worker < number of
+    /// workers): the front of its own queue, or the back of another worker's
+    /// queue if its own queue is empty. Returns false if all tiles are taken.
+    /// Safe to call concurrently from different workers.
+    bool next(unsigned int _worker, Tile& _tile);
+
+    /// number of tiles
+    size_t num_tiles() const { return tiles_.size(); }
+
+    /// number of tiles that were stolen from other workers' queues so far
+    size_t num_steals() const;
+
+private:
+
+    /// the tile queue of a worker
+    struct Queue
+    {
+        std::mutex              mutex;
+        std::deque<unsigned int> tiles;
+        size_t                  steals = 0;
+    };
+
+    /// all tiles, in Morton order
+    std::vector<Tile> tiles_;
+
+    /// one queue per worker holding indices into tiles_
+    std::vector<std::unique_ptr<Queue>> queues_;
+};
+
+
+//=============================================================================
+#endif // TILESCHEDULER_H defined
+//=============================================================================
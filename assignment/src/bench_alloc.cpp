@@ -0,0 +1,134 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "StopWatch.h"
+#include "Scene.h"
+
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <exception>
+#include <new>
+#include <stdexcept>
+
+// Microbenchmark of the ray queries: traces the primary rays of scenes and
+// the shadow rays of their hits with Scene::intersect() and
+// Scene::occluded(), and counts the heap allocations made meanwhile by
+// replacing the global operator new. Fails if a ray query allocates.
+
+/// number of calls of operator new
+static std::atomic<size_t> numAllocations(0);
+
+void* operator new(std::size_t _size)
+{
+    ++numAllocations;
+    if (void* p = std::malloc(_size ? _size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t _size)
+{
+    return operator new(_size);
+}
+
+// GCC takes the free() in a replaced operator delete for a mismatched
+// deallocation of memory from operator new
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#  pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* _p) noexcept                 { std::free(_p); }
+void operator delete[](void* _p) noexcept               { std::free(_p); }
+void operator delete(void* _p, std::size_t) noexcept    { std::free(_p); }
+void operator delete[](void* _p, std::size_t) noexcept  { std::free(_p); }
+
+/// Trace the primary rays of `_scene` `_repeat` times, and a shadow ray
+/// towards each light from every hit. Returns the number of rays traced
+/// and stores the number of allocations in `_allocations`.
+static size_t traceRays(Scene& _scene, unsigned int _repeat, size_t& _allocations)
+{
+    const Camera&             camera = _scene.getCamera();
+    const std::vector<Light>& lights = _scene.getLights();
+
+    size_t rays = 0, hits = 0;
+    const size_t before = numAllocations;
+    for (unsigned int r=0; r<_repeat; ++r)
+        for (unsigned int y=0; y<camera.height; ++y)
+            for (unsigned int x=0; x<camera.width; ++x)
+            {
+                Object_ptr object;
+                vec3       point, normal;
+                Scalar     t;
+                ++rays;
+                if (!_scene.intersect(camera.primary_ray(x, y), object, point, normal, t))
+                    continue;
+                ++hits;
+                for (const Light& light: lights)
+                {
+                    // offset the origin along the normal against self-shadowing
+                    const vec3 origin = point + normal * Scalar(1e-4);
+                    ++rays;
+                    hits += _scene.occluded(Ray(origin, light.position - origin), distance(origin, light.position));
+                }
+            }
+    _allocations = numAllocations - before;
+
+    // use the result, such that the queries are not optimized away
+    if (hits == size_t(-1)) std::cout << hits;
+    return rays;
+}
+
+/// Program entry point.
+int main(int argc, char **argv)
+try
+{
+    unsigned int repeat = 1;
+    std::vector<std::string> scenes;
+    for (int i=1; i<argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--repeat" && i+1 < argc) repeat = std::max(1, std::atoi(argv[++i]));
+        else                                 scenes.push_back(arg);
+    }
+    if (scenes.empty())
+        scenes = { "../scenes/spheres/spheres.sce", "../scenes/cylinders/cylinders.sce",
+                   "../scenes/toon_faces/toon_faces.sce", "../scenes/office/office.sce",
+                   "../scenes/rings/rings.sce" };
+
+    bool ok = true;
+    for (const std::string& path: scenes) {
+        Scene s(path);
+        StopWatch timer;
+        timer.start();
+        size_t allocations;
+        const size_t rays = traceRays(s, repeat, allocations);
+        timer.stop();
+        std::cout << path << ": " << rays << " rays in " << timer << " ("
+                  << Scalar(rays) / timer.elapsed() * 1e-3 << " Mrays/s), "
+                  << allocations << " allocations" << std::endl;
+        ok &= (allocations == 0);
+    }
+
+    if (!ok) {
+        std::cerr << "Error: ray queries allocated memory" << std::endl;
+        return 1;
+    }
+    std::cout << "No allocations per ray." << std::endl;
+    return 0;
+}
+catch (const std::exception& e)
+{
+    // e.g. invalid scene or mesh files
+    std::cerr << "\nError: " << e.what() << std::endl;
+    return 1;
+}
@@ -66,7 +66,7 @@ int main(int argc, char **argv) {
         size_t maxIntersectionCount = *std::max_element(numIntersected.begin(), numIntersected.end());
         for (int x=0; x<int(c.width); ++x)
             for (int y=0; y<int(c.height); ++y)
-                img(x, y) = vec3(numIntersected[y * c.width + x] / float(maxIntersectionCount), 0, 0);
+                img.set(x, y, vec3(numIntersected[y * c.width + x] / float(maxIntersectionCount), 0, 0));
 
         img.write(job.outPath);
     }
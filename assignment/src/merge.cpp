@@ -0,0 +1,74 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "StopWatch.h"
+#include "Image.h"
+#include "Shard.h"
+
+#include <vector>
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <exception>
+#include <stdexcept>
+
+/// Program entry point: merge the shard files written by
+/// `raytrace --shard k/N` into the final image.
+int main(int argc, char **argv)
+try
+{
+    bool outOfCore = false;
+    std::vector<std::string> args;
+    for (int i=1; i<argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--out-of-core") outOfCore = true;
+        else                        args.push_back(arg);
+    }
+
+    if (args.size() < 2) {
+        std::cerr << "Usage: " << argv[0] << " [--out-of-core] output.{tga,ppm,pfm} shard0 shard1 ...\n";
+        std::cerr << "Merges the shard files written by raytrace --shard k/N (in any order).\n";
+        std::cerr << "  --out-of-core  write the output file directly, keeping only one row in memory\n";
+        std::cerr << std::flush;
+        exit(1);
+    }
+
+    const std::string              outPath = args[0];
+    const std::vector<std::string> shards(args.begin() + 1, args.end());
+    const Image::Format            format  = Image::format(outPath);
+
+    unsigned int width, height;
+    Shard::size(shards[0], width, height);
+    if (width > Image::max_size(format) || height > Image::max_size(format))
+        throw std::runtime_error("Images in the format of " + outPath + " are limited to " +
+                                 std::to_string(Image::max_size(format)) + " pixels per side");
+
+    StopWatch timer;
+    std::cout << "Merge " << shards.size() << " shards into " << outPath << "..." << std::flush;
+    timer.start();
+    Image image;
+    if (outOfCore)
+        image.map(width, height, outPath, format);
+    else
+        image.resize(width, height);
+    Shard::merge(shards, image);
+    if (!image.is_mapped() && !image.write(outPath, format))
+        throw std::runtime_error("Cannot write image " + outPath);
+    timer.stop();
+    std::cout << "done (" << timer << ")\n";
+}
+catch (const std::exception& e)
+{
+    // e.g. missing or inconsistent shards
+    std::cerr << "\nError: " << e.what() << std::endl;
+    return 1;
+}
@@ -13,10 +13,23 @@
 #include "StopWatch.h"
 #include "Scene.h"
 
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include <iostream>
 #include <string>
+#include <sstream>
 #include <fstream>
+#include <cctype>
+#include <cstdlib>
+#include <cstdio>
+#include <exception>
+#include <iomanip>
+#include <stdexcept>
+
+#if HAVE_OPENMP
+#  include <omp.h>
+#endif
 
 #ifdef _WIN32
 #  include <windows.h>
@@ -24,8 +37,338 @@
 #  include <errhandlingapi.h>
 #endif
 
+/// Output path of frame `_frame` of an animation: `_path` used as a
+/// pattern if it contains a '%' (e.g. frame_%03d.tga), otherwise `_path`
+/// with the frame number inserted before the extension (out_0001.tga). A
+/// pattern has to contain exactly one `%d`, `%u`, or `%0Nd` (with `%%`
+/// for a literal '%'), otherwise std::runtime_error is thrown.
+static std::string framePath(const std::string& _path, unsigned int _frame)
+{
+    char number[32];
+    if (_path.find('%') != std::string::npos) {
+        // replace the directive ourselves instead of passing the path to
+        // printf as a format
+        std::string result;
+        bool        found = false;
+        for (size_t i = 0; i < _path.size(); ++i) {
+            if (_path[i] != '%') { result += _path[i]; continue; }
+            if (i+1 < _path.size() && _path[i+1] == '%') { result += '%'; ++i; continue; }
+
+            size_t j = i + 1;
+            while (j < _path.size() && std::isdigit(static_cast<unsigned char>(_path[j]))) ++j;
+            const std::string width = _path.substr(i+1, j-i-1);
+            if (found || j == _path.size() || (_path[j] != 'd' && _path[j] != 'u') ||
+                (!width.empty() && (width[0] != '0' || width.size() > 3)))
+                throw std::runtime_error("Invalid frame pattern " + _path +
+                                         " (use a single %d, %u, or %0Nd, and %% for '%')");
+            std::snprintf(number, sizeof(number), "%0*u", width.empty() ? 0 : std::atoi(width.c_str()), _frame);
+            result += number;
+            found = true;
+            i     = j;
+        }
+        return result;
+    }
+    std::snprintf(number, sizeof(number), "_%04u", _frame);
+    const size_t dot = _path.find_last_of('.');
+    const size_t sep = _path.find_last_of("/\\");
+    if (dot == std::string::npos || (sep != std::string::npos && dot < sep))
+        return _path + number;
+    return _path.substr(0, dot) + number + _path.substr(dot);
+}
+
+/// Options of a render job, given on the command line or per job in a
+/// manifest (see readManifest()).
+struct Options
+{
+    bool         wavefront     = false;
+    bool         progressive   = false;
+    int          tileSize      = 0;
+    int          aaSamples     = -1;
+    double       aaThreshold   = -1.0;  // negative: the scene's threshold
+    std::string  cameraPath;
+    bool         compactMeshes = false;
+    bool         outOfCore     = false;
+    bool         imageBytes    = false;
+    unsigned int shardIndex    = 0;
+    unsigned int shardCount    = 0;
+};
+
+/// A scene to render into an output file with its options.
+struct RaytraceJob
+{
+    std::string scenePath, outPath;
+    Options     options;
+};
+
+/// Timings (in ms) of a job, or the error that stopped it.
+struct JobReport
+{
+    double      load = 0, render = 0, write = 0, total = 0;
+    size_t      frames = 0;
+    std::string error;
+};
+
+/// Parse the option `_args[_i]` (and its value) into `_options` and advance
+/// `_i` to the last argument it used. Returns false if `_args[_i]` is not
+/// an option.
+static bool parseOption(const std::vector<std::string>& _args, size_t& _i, Options& _options)
+{
+    const std::string& arg   = _args[_i];
+    const bool         value = _i+1 < _args.size();
+    if      (arg == "--wavefront")                  _options.wavefront     = true;
+    else if (arg == "--progressive")                _options.progressive   = true;
+    else if (arg == "--tile-size" && value)         _options.tileSize      = std::atoi(_args[++_i].c_str());
+    else if (arg == "--aa" && value)                _options.aaSamples     = std::atoi(_args[++_i].c_str());
+    else if (arg == "--aa-threshold" && value)      _options.aaThreshold   = std::atof(_args[++_i].c_str());
+    else if (arg == "--camera-path" && value)       _options.cameraPath    = _args[++_i];
+    else if (arg == "--compact-meshes")             _options.compactMeshes = true;
+    else if (arg == "--out-of-core")                _options.outOfCore     = true;
+    else if (arg == "--image-bytes")                _options.imageBytes    = true;
+    else if (arg == "--shard" && value)             Shard::parse(_args[++_i], _options.shardIndex, _options.shardCount);
+    else return false;
+    return true;
+}
+
+/// Throw std::runtime_error if `_options` cannot be combined.
+static void checkOptions(const Options& _options)
+{
+    if (_options.outOfCore && (_options.wavefront || _options.progressive))
+        throw std::runtime_error("--out-of-core works with the default renderer only");
+    if (_options.outOfCore && _options.aaSamples > 1)
+        throw std::runtime_error("--out-of-core does not support antialiasing (--aa)");
+    if (_options.shardCount && (_options.wavefront || _options.progressive || _options.outOfCore || _options.imageBytes))
+        throw std::runtime_error("--shard works with the default renderer and float images only");
+}
+
+/// `_path` relative to the directory of `_base` (unless it is absolute).
+static std::string relativeTo(const std::string& _path, const std::string& _base)
+{
+    const bool absolute = !_path.empty() && (_path[0] == '/' || _path[0] == '\\' ||
+                                             (_path.size() > 1 && _path[1] == ':'));
+    const size_t sep = _base.find_last_of("/\\");
+    if (absolute || sep == std::string::npos) return _path;
+    return _base.substr(0, sep + 1) + _path;
+}
+
+/// Read a job manifest: one job per line, given by the scene file, the
+/// output file, and options (like on the command line) that override
+/// `_defaults`. Paths are relative to the manifest's directory, empty lines
+/// and lines starting with `#` are ignored. Throws std::runtime_error with
+/// the line number if the manifest is invalid.
+static std::vector<RaytraceJob> readManifest(const std::string& _filename, const Options& _defaults)
+{
+    std::ifstream ifs(_filename);
+    if (!ifs) throw std::runtime_error("Cannot open manifest " + _filename);
+
+    std::vector<RaytraceJob> jobs;
+    std::string line;
+    for (size_t lineNumber = 1; std::getline(ifs, line); ++lineNumber) {
+        std::istringstream iss(line);
+        std::vector<std::string> args;
+        for (std::string arg; iss >> arg; ) args.push_back(arg);
+        if (args.empty() || args[0][0] == '#') continue;
+
+        const std::string where = _filename + ":" + std::to_string(lineNumber) + ": ";
+        if (args.size() < 2)
+            throw std::runtime_error(where + "expected scene file, output file, and options");
+        RaytraceJob job{ relativeTo(args[0], _filename), relativeTo(args[1], _filename), _defaults };
+        job.options.cameraPath.clear();
+        for (size_t i = 2; i < args.size(); ++i)
+            if (!parseOption(args, i, job.options))
+                throw std::runtime_error(where + "invalid option " + args[i]);
+        job.options.cameraPath = job.options.cameraPath.empty() ? _defaults.cameraPath
+                                                                : relativeTo(job.options.cameraPath, _filename);
+        try { checkOptions(job.options); }
+        catch (const std::exception& e) { throw std::runtime_error(where + e.what()); }
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+/// Load the scene of `_job`, render all its frames, and write them. Reports
+/// progress on std::cout unless `_quiet` (batch mode, where only complete
+/// lines of Scene are printed), and stores the timings in `_report`.
+/// Throws std::runtime_error if the job fails.
+static void runJob(const RaytraceJob& _job, JobReport& _report, bool _quiet)
+{
+    const Options& o = _job.options;
+    std::ostream   quiet(nullptr);
+    std::ostream&  log = _quiet ? quiet : std::cout;
+
+    StopWatch total, timer;
+    total.start();
+
+    // the output format follows from the file extension, shards are
+    // written to shard files
+    const Image::Format format = o.shardCount ? Image::PFM : Image::format(_job.outPath);
+
+    log << "Read scene '" << _job.scenePath << "'...\n" << std::flush;
+    timer.start();
+    Scene s(_job.scenePath);
+    if (o.tileSize > 0) s.setTileSize(o.tileSize);
+    if (o.aaSamples >= 0)   s.setAntialiasing(o.aaSamples);
+    if (o.aaThreshold >= 0) s.setAntialiasingThreshold(o.aaThreshold);
+    if (!o.cameraPath.empty()) s.readCameraPath(o.cameraPath);
+    if (o.compactMeshes) s.compactMeshes();
+    if (o.shardCount) s.setShard(o.shardIndex, o.shardCount);
+    _report.load = timer.stop();
+    log << "done (" << s.numObjects() << " objects)\n";
+
+    // the scene file may request antialiasing, which needs the whole image
+    if (o.outOfCore && s.antialiasingSamples() > 1)
+        throw std::runtime_error("--out-of-core does not support antialiasing, which the scene requests (add --aa 0)");
+
+    const unsigned int maxSize = Image::max_size(format);
+    if (s.getCamera().width > maxSize || s.getCamera().height > maxSize)
+        throw std::runtime_error("Images in the format of " + _job.outPath + " are limited to " +
+                                 std::to_string(maxSize) + " pixels per side");
+
+    // a still image is rendered as a single frame with the scene's camera,
+    // an animation renders all frames of the camera path with the scene
+    // loaded once
+    const size_t numFrames = std::max<size_t>(1, s.numFrames());
+    StopWatch frames;
+    frames.start();
+    for (size_t frame = 0; frame < numFrames; ++frame) {
+        std::string outPath = _job.outPath;
+        if (s.numFrames()) {
+            s.setFrame(frame);
+            outPath = framePath(_job.outPath, frame + 1);
+            log << "Frame " << frame + 1 << "/" << numFrames << ": ";
+        }
+
+        log << "Ray tracing..." << std::flush;
+        timer.start();
+        Image image;
+        if (o.outOfCore) {
+            // finished tiles are written to the file and evicted from memory
+            image.map(s.getCamera().width, s.getCamera().height, outPath, format);
+            s.render(image);
+        }
+        else if (o.progressive) {
+            // write every level to the output file as soon as it is done
+            image = s.render_progressive([&](const Image& preview, unsigned int block) {
+                preview.write(outPath, format);
+                log << "\n  " << block << "x" << block << " blocks done (" << timer.stop() << " ms)" << std::flush;
+            });
+        }
+        else if (o.wavefront) {
+            image = s.render_wavefront();
+        }
+        else {
+            image = Image(s.getCamera().width, s.getShard().rows(),
+                          o.imageBytes ? Image::BYTE : Image::FLOAT);
+            s.render(image);
+        }
+        _report.render += timer.stop();
+        log << " done (" << timer << ")\n";
+
+        timer.start();
+        if (o.shardCount) {
+            log << "Write shard " << outPath << "...";
+            if (!s.getShard().write(outPath, image))
+                throw std::runtime_error("Cannot write shard " + outPath);
+            log << "done\n";
+        }
+        else if (!image.is_mapped()) {
+            log << "Write image " << outPath << "...";
+            if (!image.write(outPath, format))
+                throw std::runtime_error("Cannot write image " + outPath);
+            log << "done\n";
+        }
+        _report.write += timer.stop();
+        ++_report.frames;
+    }
+    frames.stop();
+    if (s.numFrames())
+        log << numFrames << " frames done (" << frames << ")\n";
+    _report.total = total.stop();
+}
+
+/// Run `_jobs`, at most `_maxJobs` at a time, such that one job's loading
+/// and writing overlap with other jobs' rendering. Concurrent jobs share
+/// one pool of threads: they run as tasks of a single parallel region, in
+/// which their parallel loops become tasks as well (see parallel_for()),
+/// which every idle thread helps with. A single job at a time reports its
+/// progress. Prints a table of the jobs' timings and returns whether all
+/// jobs succeeded.
+static bool runBatch(const std::vector<RaytraceJob>& _jobs, int _maxJobs)
+{
+    const int numJobs = std::max(1, std::min(_maxJobs, int(_jobs.size())));
+    std::vector<JobReport> reports(_jobs.size());
+
+    auto run = [&](int _j) {
+        if (numJobs == 1)
+            std::cout << "\nJob " << _j + 1 << "/" << _jobs.size() << ":\n";
+        try {
+            runJob(_jobs[_j], reports[_j], numJobs > 1);
+            if (numJobs > 1)
+                std::cout << "Job " + std::to_string(_j + 1) + " done: " + _jobs[_j].outPath + "\n" << std::flush;
+        }
+        catch (const std::exception& e) {
+            reports[_j].error = e.what();
+            std::cout << "Job " + std::to_string(_j + 1) + " failed: " + e.what() + "\n" << std::flush;
+        }
+    };
+
+    StopWatch wall;
+    wall.start();
+#if HAVE_OPENMP
+    if (numJobs > 1) {
+        std::cout << "Running " << _jobs.size() << " jobs, up to " << numJobs << " at a time, with "
+                  << omp_get_max_threads() << " threads shared among them." << std::endl;
+
+        // numJobs tasks take the jobs one after the other
+        std::atomic<int> next(0);
+#  pragma omp parallel
+#  pragma omp single
+        for (int w = 0; w < numJobs; ++w) {
+#  pragma omp task
+            for (int j; (j = next++) < int(_jobs.size()); )
+                run(j);
+        }
+    }
+    else
+#endif
+    {
+        for (int j = 0; j < int(_jobs.size()); ++j)
+            run(j);
+    }
+    wall.stop();
+
+    // summary table
+    size_t sceneWidth = 5, outWidth = 6;
+    for (const auto& job : _jobs) {
+        sceneWidth = std::max(sceneWidth, job.scenePath.size());
+        outWidth   = std::max(outWidth,   job.outPath.size());
+    }
+    std::cout << "\n" << std::left
+              << std::setw(4) << "Job" << "  " << std::setw(sceneWidth) << "Scene" << "  " << std::setw(outWidth) << "Output"
+              << std::right << std::setw(8) << "Frames" << std::setw(10) << "Load ms" << std::setw(12) << "Render ms"
+              << std::setw(10) << "Write ms" << std::setw(10) << "Total ms" << "\n";
+    double sum = 0;
+    bool   ok  = true;
+    std::cout << std::fixed << std::setprecision(1);
+    for (size_t j = 0; j < _jobs.size(); ++j) {
+        const JobReport& r = reports[j];
+        std::cout << std::left << std::setw(4) << j + 1 << "  " << std::setw(sceneWidth) << _jobs[j].scenePath << "  "
+                  << std::setw(outWidth) << _jobs[j].outPath << std::right;
+        if (r.error.empty())
+            std::cout << std::setw(8) << r.frames << std::setw(10) << r.load << std::setw(12) << r.render
+                      << std::setw(10) << r.write << std::setw(10) << r.total << "\n";
+        else
+            std::cout << "  FAILED: " << r.error << "\n";
+        sum += r.total;
+        ok  &= r.error.empty();
+    }
+    std::cout << "Wall time " << wall.elapsed() << " ms for " << sum << " ms of jobs\n";
+    std::cout << std::defaultfloat << std::flush;
+    return ok;
+}
+
 /// Program entry point.
 int main(int argc, char **argv)
+try
 {
 #ifdef _WIN32
     // This make crashes very visible - without them, starting the
@@ -33,14 +376,31 @@ int main(int argc, char **argv)
     // any signs of a an application crash!
     SetErrorMode(0);
 #endif
-    // Parse input scene file/output path from command line arguments
-    struct RaytraceJob { std::string scenePath, outPath; };
-    std::vector<RaytraceJob> jobs;
+    // Parse options and input scene file/output path from command line arguments
+    Options options;
+    std::string manifest;
+    int maxJobs = 0;
+    std::vector<std::string> args(argv + 1, argv + argc), files;
+    for (size_t i=0; i<args.size(); ++i) {
+        if      (parseOption(args, i, options))               continue;
+        else if (args[i] == "--batch" && i+1 < args.size())   manifest = args[++i];
+        else if (args[i] == "--jobs" && i+1 < args.size())    maxJobs  = std::max(1, std::atoi(args[++i].c_str()));
+        else                                                  files.push_back(args[i]);
+    }
+    checkOptions(options);
 
-    if (argc == 3)
-        jobs.emplace_back(RaytraceJob{argv[1], argv[2]});
-    else if ((argc == 2) && argv[1][0] == '0') {
-        jobs = { {
+    std::vector<RaytraceJob> jobs;
+    if (!manifest.empty() && files.empty()) {
+        jobs = readManifest(manifest, options);
+    }
+    else if (files.size() == 2) {
+        // a single job uses all threads and reports its progress
+        JobReport report;
+        runJob(RaytraceJob{files[0], files[1], options}, report, false);
+        return 0;
+    }
+    else if ((files.size() == 1) && files[0][0] == '0') {
+        const std::pair<const char*, const char*> scenes[] = {
             {"../scenes/spheres/spheres.sce",       "spheres.tga"},
             {"../scenes/cylinders/cylinders.sce",   "cylinders.tga"},
             {"../scenes/combo/combo.sce",           "combo.tga"},
@@ -52,29 +412,39 @@ int main(int argc, char **argv)
             {"../scenes/toon_faces/toon_faces.sce", "toon_faces.tga"},
             {"../scenes/office/office.sce",         "office.tga"},
             {"../scenes/rings/rings.sce",           "rings.tga"}
-        } };
+        };
+        for (const auto& scene : scenes)
+            jobs.push_back(RaytraceJob{scene.first, scene.second, options});
     }
     else {
-        std::cerr << "Usage: " << argv[0] << " input.sce output.tga\n";
-        std::cerr << "Or: " << argv[0] << " 0\n";
+        std::cerr << "Usage: " << argv[0] << " [options] input.sce output.{tga,ppm,pfm}\n";
+        std::cerr << "Or: " << argv[0] << " [options] [--jobs N] 0\n";
+        std::cerr << "Or: " << argv[0] << " [options] [--jobs N] --batch manifest.txt\n";
+        std::cerr << "Options:\n";
+        std::cerr << "  --wavefront    render in stages with sorted ray queues\n";
+        std::cerr << "  --progressive  render coarse-to-fine, writing the output after every level\n";
+        std::cerr << "  --tile-size N  render tiles of NxN pixels (default 32)\n";
+        std::cerr << "  --aa N         antialias edges with up to N samples per pixel (overrides the scene)\n";
+        std::cerr << "  --aa-threshold T  color difference that triggers antialiasing (overrides the scene, default 0.1)\n";
+        std::cerr << "  --camera-path F   render one frame per line (eye center up) of file F\n";
+        std::cerr << "  --compact-meshes  store meshes compactly (float positions, packed normals)\n";
+        std::cerr << "  --image-bytes     store the image with 8 bits per channel instead of floats\n";
+        std::cerr << "  --out-of-core     render directly into the output file, keeping only unfinished tiles in memory (no --aa)\n";
+        std::cerr << "  --shard k/N       render only shard k of N into a shard file, see merge\n";
+        std::cerr << "Batch options:\n";
+        std::cerr << "  --batch F      render the jobs of manifest F, one per line: input.sce output [options]\n";
+        std::cerr << "  --jobs N       render up to N jobs at a time (default 4 with --batch, 1 otherwise)\n";
         std::cerr << std::flush;
         exit(1);
     }
 
-    for (const auto &job : jobs) {
-        std::cout << "Read scene '" << job.scenePath << "'..." << std::flush;
-        Scene s(job.scenePath);
-        std::cout << "\ndone (" << s.numObjects() << " objects)\n";
-
-        StopWatch timer;
-        std::cout << "Ray tracing..." << std::flush;
-        timer.start();
-        auto image = s.render();
-        timer.stop();
-        std::cout << " done (" << timer << ")\n";
-
-        std::cout << "Write image...";
-        image.write(job.outPath);
-        std::cout << "done\n";
-    }
+    // manifests run four jobs at a time by default, `0` one after the other
+    if (maxJobs == 0) maxJobs = manifest.empty() ? 1 : 4;
+    return runBatch(jobs, maxJobs) ? 0 : 1;
+}
+catch (const std::exception& e)
+{
+    // e.g. invalid scene or mesh files
+    std::cerr << "\nError: " << e.what() << std::endl;
+    return 1;
 }
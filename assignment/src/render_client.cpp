@@ -0,0 +1,132 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "StopWatch.h"
+
+#include <vector>
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+
+#ifndef _WIN32
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+
+/// Read a line (without the line break) from `_in`. Returns false at the
+/// end of the input.
+static bool readLine(FILE* _in, std::string& _line)
+{
+    _line.clear();
+    int c;
+    while ((c = std::fgetc(_in)) != EOF && c != '\n')
+        _line += static_cast<char>(c);
+    if (!_line.empty() && _line.back() == '\r')
+        _line.pop_back();
+    return c != EOF || !_line.empty();
+}
+
+/// Program entry point: send commands to a render_server listening on a
+/// socket, print its answers, and save the rendered pixels as PPM images.
+int main(int argc, char **argv)
+try
+{
+    std::string output = "render_";
+    std::vector<std::string> args;
+    for (int i=1; i<argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--output" && i+1 < argc) output = argv[++i];
+        else                                 args.push_back(arg);
+    }
+
+    if (args.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--output prefix] socket [command ...]\n";
+        std::cerr << "Sends the commands (or the lines of stdin) to the render_server listening on\n";
+        std::cerr << "the socket and prints its answers. Rendered pixels are saved to prefix0001.ppm,\n";
+        std::cerr << "prefix0002.ppm, ... (default prefix render_).\n";
+        std::cerr << "Example: " << argv[0] << " /tmp/raytrace.sock \"render 0 0 64 64\" \"camera 0 0 5 0 0 0 0 1 0\" render\n";
+        std::cerr << std::flush;
+        exit(1);
+    }
+
+#ifdef _WIN32
+    throw std::runtime_error("render_client needs Unix domain sockets, which are not supported on Windows");
+#else
+    const std::string path = args[0];
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("Socket path " + path + " is too long");
+    path.copy(address.sun_path, path.size());
+
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0 || connect(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+        throw std::runtime_error("Cannot connect to socket " + path);
+    FILE* in  = fdopen(server, "rb");
+    FILE* out = fdopen(dup(server), "wb");
+    if (!in || !out)
+        throw std::runtime_error("Cannot connect to socket " + path);
+
+    const std::vector<std::string> commands(args.begin() + 1, args.end());
+    unsigned int images = 0;
+    std::string  command, reply;
+    for (size_t c = 0; commands.empty() ? readLine(stdin, command) : c < commands.size(); ++c) {
+        if (!commands.empty()) command = commands[c];
+        if (command.empty() || command[0] == '#') continue;
+
+        StopWatch timer;
+        timer.start();
+        std::fprintf(out, "%s\n", command.c_str());
+        std::fflush(out);
+        if (!readLine(in, reply))
+            throw std::runtime_error("Connection closed by the server");
+
+        // rendered pixels follow the answer line
+        unsigned int width, height;
+        if (std::sscanf(reply.c_str(), "PIXELS %u %u", &width, &height) == 2) {
+            std::vector<unsigned char> pixels(3 * size_t(width) * height);
+            if (std::fread(pixels.data(), 1, pixels.size(), in) != pixels.size())
+                throw std::runtime_error("Connection closed by the server");
+            timer.stop();
+
+            char filename[4096];
+            std::snprintf(filename, sizeof(filename), "%s%04u.ppm", output.c_str(), ++images);
+            FILE* file = std::fopen(filename, "wb");
+            const bool ok = file &&
+                std::fprintf(file, "P6\n%u %u\n255\n", width, height) > 0 &&
+                std::fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+            if (!file || std::fclose(file) != 0 || !ok)
+                throw std::runtime_error("Cannot write image " + std::string(filename));
+            std::cout << command << ": " << width << "x" << height << " pixels (" << timer << ") -> " << filename << std::endl;
+        }
+        else {
+            timer.stop();
+            std::cout << command << ": " << reply << " (" << timer << ")" << std::endl;
+        }
+
+        if (command == "quit" || command == "shutdown") break;
+    }
+    std::fclose(in);
+    std::fclose(out);
+    return 0;
+#endif
+}
+catch (const std::exception& e)
+{
+    // e.g. no server listening on the socket
+    std::cerr << "\nError: " << e.what() << std::endl;
+    return 1;
+}
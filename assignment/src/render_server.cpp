@@ -0,0 +1,333 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+//== includes =================================================================
+
+#include "StopWatch.h"
+#include "Scene.h"
+
+#include <vector>
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+
+#ifdef _WIN32
+#  include <fcntl.h>
+#  include <io.h>
+#else
+#  include <csignal>
+#  include <sys/socket.h>
+#  include <sys/stat.h>
+#  include <sys/un.h>
+#  include <unistd.h>
+#endif
+
+// The server loads a scene once and renders it on request, keeping the
+// objects and acceleration structures in memory between requests. It reads
+// one command per line and answers each with a line starting with `OK`
+// (followed by the answer, if any) or `ERROR` (followed by a message):
+//
+//   camera ex ey ez  cx cy cz  ux uy uz  [fovy width height]
+//                      move the camera (eye, center, up), optionally
+//                      changing its field of view and image size
+//   light i  px py pz  r g b
+//                      replace light i (position, color)
+//   material i  ambient(rgb) diffuse(rgb) specular(rgb) shininess mirror
+//                      replace the material of object i
+//   render [x y width height]
+//                      render the whole image or the given region, whose
+//                      lower left pixel is (x,y). The answer is the line
+//                      `PIXELS width height` followed by the region's
+//                      pixels as 8-bit RGB, row by row from the top (like
+//                      the pixels of a binary PPM)
+//   info               answer `OK width height lights objects`
+//   quit               close the connection
+//   shutdown           close the connection and stop the server
+
+/// What to do after a command
+enum Status
+{
+    CONTINUE, ///< read the next command
+    QUIT,     ///< close the connection
+    SHUTDOWN  ///< close the connection and stop the server
+};
+
+/// Read a line (without the line break) from `_in`. Returns false at the
+/// end of the input.
+static bool readLine(FILE* _in, std::string& _line)
+{
+    _line.clear();
+    int c;
+    while ((c = std::fgetc(_in)) != EOF && c != '\n')
+        _line += static_cast<char>(c);
+    if (!_line.empty() && _line.back() == '\r')
+        _line.pop_back();
+    return c != EOF || !_line.empty();
+}
+
+/// Write the answer line `_line` and the `_size` bytes at `_data` to `_out`.
+static void answer(FILE* _out, const std::string& _line, const void* _data = nullptr, size_t _size = 0)
+{
+    std::fwrite(_line.data(), 1, _line.size(), _out);
+    std::fputc('\n', _out);
+    if (_size) std::fwrite(_data, 1, _size, _out);
+    std::fflush(_out);
+}
+
+/// Throw std::runtime_error with the usage `_usage` if `_iss` failed to
+/// parse all arguments of a command.
+static void checkArguments(const std::istringstream& _iss, const char* _usage)
+{
+    if (_iss.fail())
+        throw std::runtime_error(std::string("expected ") + _usage);
+}
+
+/// Execute the command `_line` on scene `_scene` and write the answer to
+/// `_out`. Throws std::exception for invalid commands, which are answered
+/// with `ERROR` by the caller.
+static Status execute(Scene& _scene, const std::string& _line, FILE* _out)
+{
+    std::istringstream iss(_line);
+    std::string command;
+    iss >> command;
+
+    if (command == "camera") {
+        Camera camera = _scene.getCamera();
+        iss >> camera.eye >> camera.center >> camera.up;
+        checkArguments(iss, "camera ex ey ez cx cy cz ux uy uz [fovy width height]");
+        Scalar fovy;
+        if (iss >> fovy) {
+            unsigned int width = 0, height = 0;
+            iss >> width >> height;
+            checkArguments(iss, "camera ex ey ez cx cy cz ux uy uz [fovy width height]");
+            if (width == 0 || height == 0)
+                throw std::runtime_error("empty image");
+            camera.fovy   = fovy;
+            camera.width  = width;
+            camera.height = height;
+        }
+        camera.init();
+        _scene.setCamera(camera);
+        answer(_out, "OK");
+    }
+    else if (command == "light") {
+        size_t index;
+        iss >> index;
+        const Light light(iss);
+        checkArguments(iss, "light i px py pz r g b");
+        if (index >= _scene.getLights().size())
+            throw std::runtime_error("no light " + std::to_string(index));
+        _scene.setLight(index, light);
+        answer(_out, "OK");
+    }
+    else if (command == "material") {
+        size_t   index;
+        Material material;
+        iss >> index >> material;
+        checkArguments(iss, "material i ar ag ab dr dg db sr sg sb shininess mirror");
+        if (index >= _scene.numObjects())
+            throw std::runtime_error("no object " + std::to_string(index));
+        _scene.setMaterial(index, material);
+        answer(_out, "OK");
+    }
+    else if (command == "render") {
+        const Camera& camera = _scene.getCamera();
+        unsigned int x = 0, y = 0, width = camera.width, height = camera.height;
+        if (iss >> x) {
+            iss >> y >> width >> height;
+            checkArguments(iss, "render [x y width height]");
+        }
+        if (width == 0 || height == 0 ||
+            size_t(x) + width > camera.width || size_t(y) + height > camera.height)
+            throw std::runtime_error("region exceeds the camera's image of " +
+                                     std::to_string(camera.width) + "x" + std::to_string(camera.height) + " pixels");
+
+        StopWatch timer;
+        timer.start();
+        _scene.setRegion(x, y, width, height);
+        Image image;
+        try {
+            image = _scene.render();
+        }
+        catch (...) {
+            _scene.setRegion(0, 0, 0, 0);
+            throw;
+        }
+        _scene.setRegion(0, 0, 0, 0);
+        timer.stop();
+
+        // rows from the top, quantized like written images
+        std::vector<unsigned char> pixels(3 * size_t(width) * height);
+        unsigned char* p = pixels.data();
+        for (unsigned int j=height; j-- > 0; )
+            for (unsigned int i=0; i<width; ++i) {
+                const vec3 c = image(i, j);
+                *p++ = Image::quantize(c[0]);
+                *p++ = Image::quantize(c[1]);
+                *p++ = Image::quantize(c[2]);
+            }
+        answer(_out, "PIXELS " + std::to_string(width) + " " + std::to_string(height),
+               pixels.data(), pixels.size());
+        std::cerr << "render " << x << " " << y << " " << width << " " << height
+                  << " (" << timer << ")" << std::endl;
+    }
+    else if (command == "info") {
+        answer(_out, "OK " + std::to_string(_scene.getCamera().width) + " " +
+                             std::to_string(_scene.getCamera().height) + " " +
+                             std::to_string(_scene.getLights().size()) + " " +
+                             std::to_string(_scene.numObjects()));
+    }
+    else if (command == "quit") {
+        answer(_out, "OK");
+        return QUIT;
+    }
+    else if (command == "shutdown") {
+        answer(_out, "OK");
+        return SHUTDOWN;
+    }
+    else if (!command.empty() && command[0] != '#') {
+        throw std::runtime_error("unknown command " + command);
+    }
+    return CONTINUE;
+}
+
+/// Execute the commands read from `_in` until the input ends or a `quit`
+/// or `shutdown` command, writing the answers to `_out`.
+static Status serve(Scene& _scene, FILE* _in, FILE* _out)
+{
+    std::string line;
+    while (readLine(_in, line)) {
+        try {
+            const Status status = execute(_scene, line, _out);
+            if (status != CONTINUE) return status;
+        }
+        catch (const std::exception& e) {
+            std::string message = e.what();
+            for (char& c: message) if (c == '\n') c = ' ';
+            answer(_out, "ERROR " + message);
+        }
+    }
+    return QUIT;
+}
+
+#ifndef _WIN32
+/// Serve the clients connecting to the Unix domain socket `_path` one
+/// after the other, until one sends `shutdown`.
+static void serveSocket(Scene& _scene, const std::string& _path)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (_path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("Socket path " + _path + " is too long");
+    _path.copy(address.sun_path, _path.size());
+
+    // replace the socket of a previous server, but no other files
+    struct stat info;
+    if (lstat(_path.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode))
+            throw std::runtime_error(_path + " exists and is not a socket");
+        unlink(_path.c_str());
+    }
+
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0 ||
+        bind(server, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(server, 4) != 0) {
+        if (server >= 0) close(server);
+        throw std::runtime_error("Cannot listen on socket " + _path);
+    }
+
+    // a client closing its connection early must not stop the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::cout << "Listening on " << _path << std::endl;
+    Status status = CONTINUE;
+    while (status != SHUTDOWN) {
+        const int client = accept(server, nullptr, nullptr);
+        if (client < 0) continue;
+        FILE* in  = fdopen(client, "rb");
+        FILE* out = fdopen(dup(client), "wb");
+        if (in && out)
+            status = serve(_scene, in, out);
+        if (in)  std::fclose(in);
+        if (out) std::fclose(out);
+    }
+    close(server);
+    unlink(_path.c_str());
+}
+#endif
+
+/// Program entry point.
+int main(int argc, char **argv)
+try
+{
+    std::string socketPath;
+    int tileSize = 0, aaSamples = -1;
+    std::vector<std::string> files;
+    for (int i=1; i<argc; ++i) {
+        const std::string arg = argv[i];
+        if      (arg == "--socket" && i+1 < argc)    socketPath = argv[++i];
+        else if (arg == "--tile-size" && i+1 < argc) tileSize   = std::atoi(argv[++i]);
+        else if (arg == "--aa" && i+1 < argc)        aaSamples  = std::atoi(argv[++i]);
+        else                                         files.push_back(arg);
+    }
+
+    if (files.size() != 1) {
+        std::cerr << "Usage: " << argv[0] << " [options] input.sce\n";
+        std::cerr << "Loads the scene once and renders it on request. Reads commands from stdin\n";
+        std::cerr << "and writes answers to stdout, or serves clients connecting to a socket\n";
+        std::cerr << "(see render_client). The commands are described in render_server.cpp.\n";
+        std::cerr << "Options:\n";
+        std::cerr << "  --socket F     listen on the Unix domain socket F instead of stdin/stdout\n";
+        std::cerr << "  --tile-size N  render tiles of NxN pixels (default 32)\n";
+        std::cerr << "  --aa N         antialias edges with up to N samples per pixel (overrides the scene)\n";
+        std::cerr << std::flush;
+        exit(1);
+    }
+
+    // answers are written to stdout, so log messages go to stderr
+    if (socketPath.empty())
+        std::cout.rdbuf(std::cerr.rdbuf());
+
+    StopWatch timer;
+    std::cout << "Read scene '" << files[0] << "'...\n" << std::flush;
+    timer.start();
+    Scene s(files[0]);
+    if (tileSize > 0) s.setTileSize(tileSize);
+    if (aaSamples >= 0) s.setAntialiasing(aaSamples);
+    timer.stop();
+    std::cout << "done (" << s.numObjects() << " objects, " << timer << ")" << std::endl;
+
+    if (!socketPath.empty()) {
+#ifdef _WIN32
+        throw std::runtime_error("--socket is not supported on Windows");
+#else
+        serveSocket(s, socketPath);
+#endif
+    }
+    else {
+#ifdef _WIN32
+        _setmode(_fileno(stdin),  _O_BINARY);
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        serve(s, stdin, stdout);
+    }
+    return 0;
+}
+catch (const std::exception& e)
+{
+    // e.g. invalid scene or mesh files
+    std::cerr << "\nError: " << e.what() << std::endl;
+    return 1;
+}
@@ -25,6 +25,16 @@
 /// \file vec3.h Implements the vector class and its mathematical operations.
 
 
+/// Scalar type of all geometric and color computations. Double precision by
+/// default, single precision if compiled with RAYTRACE_FLOAT=1 (e.g. the
+/// raytrace_float target), which halves the size of vertices and pixels.
+#if RAYTRACE_FLOAT
+typedef float Scalar;
+#else
+typedef double Scalar;
+#endif
+
+
 /// \class vec3 vec3.h
 /// This class implements a simple 3D vector, that we use to represent
 /// 3D points and 3D color. You can access the individual components either by
@@ -35,7 +45,7 @@ class vec3
 {
 private:
 
-    double data_[3];
+    Scalar data_[3];
 
 public:
 
@@ -44,22 +54,22 @@ public:
 
     /// construct with scalar value that is assigned to x, y, and z
     /// The "explicit" keyword prevents automatic conversions
-    /// from double to vec3, which generally should indicate bugs.
-    explicit vec3(double _s) : data_{_s,_s,_s} {}
+    /// from Scalar to vec3, which generally should indicate bugs.
+    explicit vec3(Scalar _s) : data_{_s,_s,_s} {}
 
     /// construct with x,y,z values
-    vec3(double _x, double _y, double _z) : data_{_x,_y,_z} {}
+    vec3(Scalar _x, Scalar _y, Scalar _z) : data_{_x,_y,_z} {}
 
 
     /// read/write the _i'th vector component (_i from 0 to 2)
-    double& operator[](unsigned int _i)
+    Scalar& operator[](unsigned int _i)
     {
         assert(_i < 3);
         return data_[_i];
     }
 
     /// read the _i'th vector component (_i from 0 to 2)
-    const double operator[](unsigned int _i) const
+    const Scalar operator[](unsigned int _i) const
     {
         assert(_i < 3);
         return data_[_i];
@@ -67,14 +77,14 @@ public:
 
 
     /// multiply this vector by a scalar \c s
-    vec3& operator*=(const double s)
+    vec3& operator*=(const Scalar s)
     {
         for (int i=0; i<3; ++i) data_[i] *= s;
         return *this;
     }
 
     /// divide this vector by a scalar \c s
-    vec3& operator/=(const double s)
+    vec3& operator/=(const Scalar s)
     {
         for (int i=0; i<3; ++i) data_[i] /= s;
         return *this;
@@ -113,7 +123,7 @@ inline const vec3 operator-(const vec3& v)
 }
 
 /// multiply vector \c v by scalar \c s
-inline const vec3 operator*(const double s, const vec3& v )
+inline const vec3 operator*(const Scalar s, const vec3& v )
 {
     return vec3(s * v[0],
                 s * v[1],
@@ -121,7 +131,7 @@ inline const vec3 operator*(const double s, const vec3& v )
 }
 
 /// multiply vector \c v by scalar \c s
-inline const vec3 operator*(const vec3& v, const double s)
+inline const vec3 operator*(const vec3& v, const Scalar s)
 {
     return vec3(s * v[0],
                 s * v[1],
@@ -137,7 +147,7 @@ inline const vec3 operator*(const vec3& v0, const vec3& v1)
 }
 
 /// divide vector \c v by scalar \c s
-inline const vec3 operator/(const vec3& v, const double s)
+inline const vec3 operator/(const vec3& v, const Scalar s)
 {
     return vec3(v[0] / s,
                 v[1] / s,
@@ -177,13 +187,13 @@ inline const vec3 max(const vec3& v0, const vec3& v1)
 }
 
 /// compute the Euclidean dot product of \c v0 and \c v1
-inline const double dot(const vec3& v0, const vec3& v1)
+inline const Scalar dot(const vec3& v0, const vec3& v1)
 {
     return (v0[0]*v1[0] + v0[1]*v1[1] + v0[2]*v1[2]);
 }
 
 /// compute the Euclidean norm (length) of a vector \c v
-inline const double norm(const vec3& v)
+inline const Scalar norm(const vec3& v)
 {
     return sqrt(dot(v,v));
 }
@@ -191,7 +201,7 @@ inline const double norm(const vec3& v)
 /// normalize vector \c v by dividing it by its norm
 inline const vec3 normalize(const vec3& v)
 {
-    const double n = norm(v);
+    const Scalar n = norm(v);
     if (n != 0.0)
     {
         return vec3(v[0] / n,
@@ -202,7 +212,7 @@ inline const vec3 normalize(const vec3& v)
 }
 
 /// compute the distance between vectors \c v0 and \c v1
-inline const double distance(const vec3& v0, const vec3& v1)
+inline const Scalar distance(const vec3& v0, const vec3& v1)
 {
     return norm(v0-v1);
 }
@@ -0,0 +1,346 @@
+//=============================================================================
+//
+//   Exercise code for the lecture
+//   "Introduction to Computer Graphics"
+//   by Prof. Dr. Mario Botsch, Bielefeld University
+//
+//   Copyright (C) Computer Graphics Group, Bielefeld University.
+//
+//=============================================================================
+
+#ifndef VEC3XN_H
+#define VEC3XN_H
+
+//== INCLUDES =================================================================
+
+#include "vec3.h"
+
+
+//== CLASS DEFINITION =========================================================
+
+
+/// \file vec3xN.h Implements batches of N scalars and N vectors and their
+/// mathematical operations, which process all N entries at once.
+
+
+/// \class scalarN vec3xN.h
+/// This class implements a batch of N scalars, e.g. the ray parameters of
+/// the N rays of a packet. All operations loop over the N entries, such that
+/// compilers map them to SIMD instructions.
+template <int N>
+class scalarN
+{
+private:
+
+    alignas(32) Scalar data_[N];
+
+public:
+
+    /// default constructor
+    scalarN() {}
+
+    /// construct with scalar value that is assigned to all entries
+    explicit scalarN(Scalar _s) { for (int i=0; i<N; ++i) data_[i] = _s; }
+
+    /// read/write the _i'th entry (_i from 0 to N-1)
+    Scalar& operator[](int _i)
+    {
+        assert(_i < N);
+        return data_[_i];
+    }
+
+    /// read the _i'th entry (_i from 0 to N-1)
+    Scalar operator[](int _i) const
+    {
+        assert(_i < N);
+        return data_[_i];
+    }
+};
+
+
+/// \class vec3xN vec3xN.h
+/// This class implements a batch of N 3D vectors, e.g. the directions of the
+/// N rays of a packet or the centers of N spheres. The vectors are stored
+/// component-wise (structure of arrays): all x coordinates, then all y
+/// coordinates, then all z coordinates. The free functions (dot, cross,
+/// normalize, ...) mirror those of vec3 and process all N vectors at once,
+/// each operation on one component running over N consecutive scalars.
+/// \sa vec3xN.h
+template <int N>
+class vec3xN
+{
+private:
+
+    alignas(32) Scalar data_[3][N];
+
+public:
+
+    /// default constructor
+    vec3xN() {}
+
+    /// construct with the vector \c _v assigned to all entries
+    explicit vec3xN(const vec3& _v)
+    {
+        for (int c=0; c<3; ++c)
+            for (int i=0; i<N; ++i)
+                data_[c][i] = _v[c];
+    }
+
+    /// the N values of component \c _c (0, 1, 2 for x, y, z)
+    Scalar* operator[](int _c)
+    {
+        assert(_c < 3);
+        return data_[_c];
+    }
+
+    /// the N values of component \c _c (0, 1, 2 for x, y, z)
+    const Scalar* operator[](int _c) const
+    {
+        assert(_c < 3);
+        return data_[_c];
+    }
+
+    /// read the _i'th vector (_i from 0 to N-1)
+    vec3 get(int _i) const
+    {
+        assert(_i < N);
+        return vec3(data_[0][_i], data_[1][_i], data_[2][_i]);
+    }
+
+    /// write the _i'th vector (_i from 0 to N-1)
+    void set(int _i, const vec3& _v)
+    {
+        assert(_i < N);
+        for (int c=0; c<3; ++c) data_[c][_i] = _v[c];
+    }
+};
+
+
+//-----------------------------------------------------------------------------
+
+
+/// add two batches \c s0 and \c s1
+template <int N>
+inline scalarN<N> operator+(const scalarN<N>& s0, const scalarN<N>& s1)
+{
+    scalarN<N> r;
+    for (int i=0; i<N; ++i) r[i] = s0[i] + s1[i];
+    return r;
+}
+
+/// subtract batch \c s1 from batch \c s0
+template <int N>
+inline scalarN<N> operator-(const scalarN<N>& s0, const scalarN<N>& s1)
+{
+    scalarN<N> r;
+    for (int i=0; i<N; ++i) r[i] = s0[i] - s1[i];
+    return r;
+}
+
+/// subtract scalar \c s from all entries of batch \c s0
+template <int N>
+inline scalarN<N> operator-(const scalarN<N>& s0, const Scalar s)
+{
+    scalarN<N> r;
+    for (int i=0; i<N; ++i) r[i] = s0[i] - s;
+    return r;
+}
+
+/// multiply two batches \c s0 and \c s1 entry by entry
+template <int N>
+inline scalarN<N> operator*(const scalarN<N>& s0, const scalarN<N>& s1)
+{
+    scalarN<N> r;
+    for (int i=0; i<N; ++i) r[i] = s0[i] * s1[i];
+    return r;
+}
+
+/// multiply all entries of batch \c s0 by scalar \c s
+template <int N>
+inline scalarN<N> operator*(const Scalar s, const scalarN<N>& s0)
+{
+    scalarN<N> r;
+    for (int i=0; i<N; ++i) r[i] = s * s0[i];
+    return r;
+}
+
+/// compute the square roots of all entries of batch \c s
+template <int N>
+inline scalarN<N> sqrt(const scalarN<N>& s)
+{
+    scalarN<N> r;
+    for (int i=0; i<N; ++i) r[i] = std::sqrt(s[i]);
+    return r;
+}
+
+
+//-----------------------------------------------------------------------------
+
+
+/// add two batches of vectors \c v0 and \c v1
+template <int N>
+inline vec3xN<N> operator+(const vec3xN<N>& v0, const vec3xN<N>& v1)
+{
+    vec3xN<N> r;
+    for (int c=0; c<3; ++c)
+        for (int i=0; i<N; ++i)
+            r[c][i] = v0[c][i] + v1[c][i];
+    return r;
+}
+
+/// subtract batch \c v1 from batch \c v0
+template <int N>
+inline vec3xN<N> operator-(const vec3xN<N>& v0, const vec3xN<N>& v1)
+{
+    vec3xN<N> r;
+    for (int c=0; c<3; ++c)
+        for (int i=0; i<N; ++i)
+            r[c][i] = v0[c][i] - v1[c][i];
+    return r;
+}
+
+/// subtract vector \c v from all vectors of batch \c v0
+template <int N>
+inline vec3xN<N> operator-(const vec3xN<N>& v0, const vec3& v)
+{
+    vec3xN<N> r;
+    for (int c=0; c<3; ++c)
+        for (int i=0; i<N; ++i)
+            r[c][i] = v0[c][i] - v[c];
+    return r;
+}
+
+/// multiply vector i of batch \c v by entry i of batch \c s
+template <int N>
+inline vec3xN<N> operator*(const scalarN<N>& s, const vec3xN<N>& v)
+{
+    vec3xN<N> r;
+    for (int c=0; c<3; ++c)
+        for (int i=0; i<N; ++i)
+            r[c][i] = s[i] * v[c][i];
+    return r;
+}
+
+/// multiply all vectors of batch \c v by scalar \c s
+template <int N>
+inline vec3xN<N> operator*(const Scalar s, const vec3xN<N>& v)
+{
+    vec3xN<N> r;
+    for (int c=0; c<3; ++c)
+        for (int i=0; i<N; ++i)
+            r[c][i] = s * v[c][i];
+    return r;
+}
+
+/// divide vector i of batch \c v by entry i of batch \c s
+template <int N>
+inline vec3xN<N> operator/(const vec3xN<N>& v, const scalarN<N>& s)
+{
+    vec3xN<N> r;
+    for (int c=0; c<3; ++c)
+        for (int i=0; i<N; ++i)
+            r[c][i] = v[c][i] / s[i];
+    return r;
+}
+
+/// compute the component-wise minima of the vectors of batches \c v0 and \c v1
+template <int N>
+inline vec3xN<N> min(const vec3xN<N>& v0, const vec3xN<N>& v1)
+{
+    vec3xN<N> r;
+    for (int c=0; c<3; ++c)
+        for (int i=0; i<N; ++i)
+            r[c][i] = std::min(v0[c][i], v1[c][i]);
+    return r;
+}
+
+/// compute the component-wise maxima of the vectors of batches \c v0 and \c v1
+template <int N>
+inline vec3xN<N> max(const vec3xN<N>& v0, const vec3xN<N>& v1)
+{
+    vec3xN<N> r;
+    for (int c=0; c<3; ++c)
+        for (int i=0; i<N; ++i)
+            r[c][i] = std::max(v0[c][i], v1[c][i]);
+    return r;
+}
+
+/// compute the dot products of the vectors of batches \c v0 and \c v1
+template <int N>
+inline scalarN<N> dot(const vec3xN<N>& v0, const vec3xN<N>& v1)
+{
+    scalarN<N> r;
+    for (int i=0; i<N; ++i)
+        r[i] = v0[0][i]*v1[0][i] + v0[1][i]*v1[1][i] + v0[2][i]*v1[2][i];
+    return r;
+}
+
+/// compute the dot products of the vectors of batch \c v0 with vector \c v
+template <int N>
+inline scalarN<N> dot(const vec3xN<N>& v0, const vec3& v)
+{
+    scalarN<N> r;
+    for (int i=0; i<N; ++i)
+        r[i] = v0[0][i]*v[0] + v0[1][i]*v[1] + v0[2][i]*v[2];
+    return r;
+}
+
+/// compute the dot products of vector \c v with the vectors of batch \c v0
+template <int N>
+inline scalarN<N> dot(const vec3& v, const vec3xN<N>& v0)
+{
+    scalarN<N> r;
+    for (int i=0; i<N; ++i)
+        r[i] = v[0]*v0[0][i] + v[1]*v0[1][i] + v[2]*v0[2][i];
+    return r;
+}
+
+/// compute the Euclidean norms (lengths) of the vectors of batch \c v
+template <int N>
+inline scalarN<N> norm(const vec3xN<N>& v)
+{
+    return sqrt(dot(v,v));
+}
+
+/// normalize the vectors of batch \c v, zero vectors are kept
+template <int N>
+inline vec3xN<N> normalize(const vec3xN<N>& v)
+{
+    scalarN<N> n = norm(v);
+    for (int i=0; i<N; ++i)
+        if (n[i] == 0.0) n[i] = 1.0;
+    return v / n;
+}
+
+/// compute the cross products of the vectors of batches \c v0 and \c v1
+template <int N>
+inline vec3xN<N> cross(const vec3xN<N>& v0, const vec3xN<N>& v1)
+{
+    vec3xN<N> r;
+    for (int i=0; i<N; ++i)
+    {
+        r[0][i] = v0[1][i]*v1[2][i] - v0[2][i]*v1[1][i];
+        r[1][i] = v0[2][i]*v1[0][i] - v0[0][i]*v1[2][i];
+        r[2][i] = v0[0][i]*v1[1][i] - v0[1][i]*v1[0][i];
+    }
+    return r;
+}
+
+/// reflect the vectors of batch \c v at the normals of batch \c n
+template <int N>
+inline vec3xN<N> reflect(const vec3xN<N>& v, const vec3xN<N>& n)
+{
+    return v - (Scalar(2) * dot(n,v)) * n;
+}
+
+/// mirror the vectors of batch \c v at the normals of batch \c n
+template <int N>
+inline vec3xN<N> mirror(const vec3xN<N>& v, const vec3xN<N>& n)
+{
+    return (Scalar(2) * dot(n,v)) * n - v;
+}
+
+
+//=============================================================================
+#endif // VEC3XN_H
+//=============================================================================